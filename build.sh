@@ -1,11 +1,140 @@
-rm avrgcc/throwie2.*
+mkdir -p avrgcc
+rm -f avrgcc/throwie2.*
+
+# MORSE's message, packed into avrgcc/morse.h, e.g. MORSE_MESSAGE="SOS" ./build.sh
+cc -std=gnu99 -Wall -O2 -o avrgcc/morse tools/morse.c tools/morsecode.c
+avrgcc/morse "${MORSE_MESSAGE:-TESTING}" > avrgcc/morse.h || exit 1
+
+# Curve tables for EASE_CURVE and LED_GAMMA, sampled into avrgcc/curves.h, the sizes
+# can be set with e.g. CURVES="-e 5" ./build.sh (see tools/curves.c)
+cc -std=gnu99 -Wall -O2 -o avrgcc/curves tools/curves.c -lm
+avrgcc/curves $CURVES > avrgcc/curves.h || exit 1
+
+# PATTERN's bytecode, assembled into avrgcc/bytecode.h, e.g.
+# PATTERN_FILE=tools/patterns/siren.pat ./build.sh with -DPATTERN=1. A list
+# of files, e.g. PATTERN_FILE="tools/patterns/breathe.pat tools/patterns/siren.pat",
+# makes an image that switches between them
+cc -std=gnu99 -Wall -O2 -o avrgcc/pattern tools/pattern.c tools/morsecode.c
+avrgcc/pattern ${PATTERN_FILE:-tools/patterns/breathe.pat} > avrgcc/bytecode.h || exit 1
 
 avr-gcc -mmcu=attiny5 \
     -Wl,--print-memory-usage -Wl,--gc-sections -Wl,--print-gc-sections \
     -fstack-usage -fdata-sections -ffunction-sections -flto \
-    -Wall -Os -o avrgcc/throwie2.elf main.c
+    -Wall -Os -Iavrgcc -o avrgcc/throwie2.elf main.c
 
-# print object sizes
+# print object sizes, and flash and SRAM in total
 nm -S --size-sort avrgcc/throwie2.elf
+avr-size avrgcc/throwie2.elf
 
 avr-objcopy -j .text -j .data -O ihex avrgcc/throwie2.elf avrgcc/throwie2.hex
+
+# host-side AVR reduced core emulator, e.g. avrgcc/avrsim -t 10m avrgcc/throwie2.elf
+cc -std=gnu99 -Wall -O2 -o avrgcc/avrsim tools/avrsim.c tools/avrrc.c tools/light.c
+
+# SRAM: .data and .bss plus the deepest stack over a night and a day,
+# fails the build when they don't fit in the 32 bytes together
+avrgcc/avrsim -r -L tools/night.light -t 24h avrgcc/throwie2.elf || exit 1
+
+# SK6803 timing of every bit sent in 10 s, fails the build when out of spec
+cc -std=gnu99 -Wall -O2 -o avrgcc/ledcheck tools/ledcheck.c tools/avrrc.c tools/light.c
+avrgcc/ledcheck -o avrgcc/throwie2.vcd avrgcc/throwie2.elf || exit 1
+
+# main.c as a virtual device on the host, a night in well under a second,
+# e.g. avrgcc/throwie2-host -L tools/night.light -o frames.csv (add -DMORSE=1
+# etc. for another effect)
+cc -std=gnu99 -Wall -O2 -DHOST -Itools/host -Iavrgcc -o avrgcc/throwie2-host main.c tools/host/host.c tools/light.c
+
+# PATTERN with breathe.pat over tools/dusks.light, fails when a run after
+# dawn and dusk doesn't start dark again but where the last one left off
+mkdir -p avrgcc/dusks
+avrgcc/pattern tools/patterns/breathe.pat > avrgcc/dusks/bytecode.h 2> /dev/null || exit 1
+cc -std=gnu99 -Wall -O2 -DHOST -DPATTERN=1 -Itools/host -Iavrgcc/dusks -Iavrgcc \
+    -o avrgcc/dusks/throwie2-host main.c tools/host/host.c tools/light.c
+avrgcc/dusks/throwie2-host -d -L tools/dusks.light -o /dev/null || exit 1
+
+# Charge per night and coin cell life of every effect over tools/night.light.
+# That's a few minutes of emulation, so it only runs as ./build.sh energy,
+# and fails when an effect draws more than 2% over tools/energy.baseline
+# or isn't in it. The build never writes the baseline by itself: the first
+# time, and after an intended change, write it with ENERGY=-u ./build.sh
+# energy and commit it (with the change).
+if [ "$1" = energy ]; then
+    if [ ! -f tools/energy.baseline ] && [ "$ENERGY" != -u ]; then
+        echo "no tools/energy.baseline yet, write it with ENERGY=-u ./build.sh energy and commit it"
+        exit 1
+    fi
+    for effect in BREATHE FLICKER SIREN MORSE; do
+        avr-gcc -mmcu=attiny5 -Wl,--gc-sections -fdata-sections -ffunction-sections -flto \
+            -Wall -Os -Iavrgcc -D$effect=1 -o avrgcc/$effect.elf main.c || exit 1
+    done
+    cc -std=gnu99 -Wall -O2 -o avrgcc/energy tools/energy.c tools/avrrc.c tools/light.c
+    avrgcc/energy $ENERGY -g tools/energy.baseline avrgcc/BREATHE.elf avrgcc/FLICKER.elf \
+        avrgcc/SIREN.elf avrgcc/MORSE.elf || exit 1
+fi
+
+# lib8tion's error over every 8-bit, 8x8 (and 16-bit) input against float
+# references, plus cycles and flash per function for the ATtiny5 on the
+# AVRrc model, one image per function, as ./build.sh lib8
+if [ "$1" = lib8 ]; then
+    for f in U8:none U88:qadd8 U88:qsub8 U88:avg8 U88:mul8 U88:qmul8 U8_16:sqrt16 \
+        U888:blend8 U888:lerp8by8 U88:scale8 U88:scale8_video U16_8:scale16by8 \
+        U8:dim8_raw U8:dim8_video U8:sin8 U8:cos8 U16:sin16 U16:cos16 \
+        U8:ease8InOutQuad U8:ease8InOutCubic U8:ease8InOutApprox U16:ease16InOutQuad \
+        U16:ease16InOutApprox U8:triwave8 U8:quadwave8 U8:cubicwave8 \
+        U16:ease_curve U16:breath_curve U16:gamma_curve U8_16:noise8 U888:hsv_rainbow U8:palette16; do
+        avr-gcc -mmcu=attiny5 -Wl,--gc-sections -fdata-sections -ffunction-sections \
+            -Wall -Os -Iavrgcc -DKIND=${f%%:*} -DBENCH=${f#*:} -o avrgcc/lib8-${f#*:}.elf tools/lib8bench_avr.c || exit 1
+    done
+    cc -std=gnu99 -Wall -O2 -DLIB8_MULFREE=1 -Iavrgcc -o avrgcc/lib8bench tools/lib8bench.c tools/avrrc.c -lm
+    avrgcc/lib8bench -b avrgcc/lib8-none.elf avrgcc/lib8-*.elf || exit 1
+fi
+
+# tiny_rand()'s period, chi-square, serial correlation and power-on
+# streams next to the LFSR it replaced and lib8tion's random8(), plus
+# cycles and flash per call on the AVRrc model, as ./build.sh rand
+if [ "$1" = rand ]; then
+    for rng in none lfsr8 xorshift16 random8; do
+        avr-gcc -mmcu=attiny5 -Wl,--gc-sections -fdata-sections -ffunction-sections \
+            -Wall -Os -DRNG=$rng -o avrgcc/rand-$rng.elf tools/randtest_avr.c || exit 1
+    done
+    cc -std=gnu99 -Wall -O2 -DLIB8_MULFREE=1 -o avrgcc/randtest tools/randtest.c tools/avrrc.c -lm
+    avrgcc/randtest -b avrgcc/rand-none.elf avrgcc/rand-*.elf || exit 1
+fi
+
+# Flash of an image with each effect against the ATtiny5's 512 bytes,
+# and SRAM with the deepest stack over tools/night.light against its 32
+# (failing like the main build's check): every C effect, PATTERN with
+# each of tools/patterns/*.pat, and PATTERN with all of them switched by
+# the light gesture, then the C effects and PATTERN with all of them
+# again with LED_COUNT 2, as ./build.sh sizes
+if [ "$1" = sizes ]; then
+    mkdir -p avrgcc/sizes
+    flash() {
+        name=$1
+        shift
+        avr-gcc -mmcu=attiny5 -Wl,--gc-sections -fdata-sections -ffunction-sections -flto \
+            -Wall -Os -Iavrgcc/sizes -Iavrgcc "$@" -o avrgcc/sizes/$name.elf main.c || exit 1
+        avr-size avrgcc/sizes/$name.elf |
+            awk -v name=$name 'NR == 2 { printf "%-20s %4d of 512 bytes", name, $1 + $2 }'
+        sim=$(avrgcc/avrsim -r -L tools/night.light -t 24h avrgcc/sizes/$name.elf)
+        status=$?
+        echo "$sim" | sed -n 's/^  SRAM: /, SRAM /p'
+        [ $status = 0 ] || exit 1
+    }
+    for effect in BREATHE FLICKER SIREN MORSE; do
+        flash $effect -D$effect=1
+    done
+    flash BREATHE-gamma -DBREATHE=1 -DLED_GAMMA=1
+    flash BREATHE-hue -DBREATHE=1 -DBREATHE_COLOR=1
+    flash BREATHE-palette -DBREATHE=1 -DBREATHE_COLOR=2
+    for pat in tools/patterns/*.pat; do
+        avrgcc/pattern $pat > avrgcc/sizes/bytecode.h 2> /dev/null || exit 1
+        flash PATTERN-$(basename $pat .pat) -DPATTERN=1
+    done
+    avrgcc/pattern tools/patterns/*.pat > avrgcc/sizes/bytecode.h || exit 1
+    flash PATTERN-all -DPATTERN=1
+    for effect in BREATHE FLICKER SIREN MORSE; do
+        flash $effect-2 -D$effect=1 -DLED_COUNT=2
+    done
+    flash PATTERN-all-2 -DPATTERN=1 -DLED_COUNT=2
+fi
@@ -110,6 +110,7 @@
  ease8InOutCubic(x) == 3(x^i) - 2(x^3)
  ease8InOutApprox(x) ==
  faster, rougher, approximation of cubic easing
+ ease16InOutApprox(x) == the same for a fract16
  ease8InOutQuad(x) == quadratic (vs cubic) easing
 
  - Cubic, Quadratic, and Triangle wave functions.
@@ -121,6 +122,11 @@
  quadwave8(x)
  triwave8(x)
 
+ - Smooth 1D value noise from a position or time counter,
+ a new random value every 256 steps, eased between.
+ noise8(x)  == 0-255, band limited
+ noise8_hash(i) == the random value of lattice point i
+
  - Square root for 16-bit integers.  About three times
  faster and five times smaller than Arduino's built-in
  generic 32-bit sqrt routine.
@@ -169,6 +175,13 @@
  BPM88 is beats per minute in ONLY Q8.8 fixed-point
  form.
 
+ - Colour from a rainbow hue or a 16 entry palette,
+ written through pointers so no RGB triple has to be
+ kept around. Shift-adds at full saturation and value.
+ hsv2rgb_rainbow(hue, sat, val, &r, &g, &b)
+ color_from_palette16(palette, index, &r, &g, &b)
+ == palette entry index/16, blend8()ed towards the next
+
  Lib8tion is pronounced like 'libation': lie-BAY-shun
 
  */
@@ -180,6 +193,43 @@
 #define LIB8STATIC               __attribute__ ((unused)) static inline
 #define LIB8STATIC_ALWAYS_INLINE __attribute__ ((always_inline)) static inline
 
+// The reduced AVR core (ATtiny4/5/9/10) has no MUL instruction, so every
+// '*' below turns into a call to libgcc's __mulhi3, a 16x16 shift-and-add
+// loop that runs until one operand is used up. With LIB8_MULFREE set, the
+// functions that multiply go through mul8by8() instead, an 8x8 shift-and-add
+// loop that is hand written in asm for the reduced core and in plain C
+// everywhere else, so host builds can check it gives the same results.
+//
+// Cycle counts on AVRrc, counted from the instruction sequences (libgcc's
+// loop length depends on the operands, typical 8-bit values shown), and
+// flash for one call site:
+//
+//   function         libgcc '*'      LIB8_MULFREE    flash (mulfree)
+//   mul8by8          ~115 (call)     59              20 bytes
+//   scale8           ~120            62              +6 bytes
+//   scale8_video     ~125            66              +10 bytes
+//   nscale8x3        ~370            ~195            3x scale8
+//   blend8           ~240            ~72             +18 bytes
+//   lerp8by8         ~125            ~68             +12 bytes
+//   random8          ~190            ~16             26 bytes, no loop
+//   ease8InOutCubic  ~250            ~135            2x scale8 + 16 bytes
+//   hsv2rgb_rainbow  ~55 / ~1030     ~55 / ~560      ~90 bytes + 4x scale8
+//   palette16 blend  ~740            ~240            3x blend8 + ~24 bytes
+//   noise8           ~170            ~120            lerp8by8 + ~50 bytes
+//
+// hsv2rgb_rainbow at full saturation and value / with both below 255,
+// color_from_palette16 between two entries (on an entry it's ~20).
+//
+// __mulhi3 itself is ~30 bytes and is no longer linked in once nothing
+// multiplies.
+#ifndef LIB8_MULFREE
+#if defined(__AVR_TINY__)
+#define LIB8_MULFREE 1
+#else
+#define LIB8_MULFREE 0
+#endif
+#endif
+
 ///@defgroup lib8tion Fast math functions
 ///A variety of functions for working with numbers.
 ///@{
@@ -267,6 +317,7 @@ typedef union
 #include "lib8tion/scale8.h"
 #include "lib8tion/random8.h"
 #include "lib8tion/trig8.h"
+#include "lib8tion/color8.h"
 
 ///////////////////////////////////////////////////////////////////////
 //
@@ -477,7 +528,11 @@ LIB8STATIC fract8 ease8InOutCubic(fract8 i)
     uint8_t ii = scale8(i, i);
     uint8_t iii = scale8(ii, i);
 
+#if LIB8_MULFREE
+    uint16_t r1 = ii + ((uint16_t) (ii) << 1) - ((uint16_t) (iii) << 1);
+#else
     uint16_t r1 = (3 * (uint16_t) (ii)) - (2 * (uint16_t) (iii));
+#endif
 
     /* the code generated for the above *'s automatically
      cleans up R1, so there's no need to explicitily call
@@ -495,8 +550,9 @@ LIB8STATIC fract8 ease8InOutCubic(fract8 i)
 
 /// ease8InOutApprox: fast, rough 8-bit ease-in/ease-out function
 ///                   shaped approximately like 'ease8InOutCubic',
-///                   it's never off by more than a couple of percent
-///                   from the actual cubic S-curve, and it executes
+///                   it's never off by more than 3.3% of full scale
+///                   (8 steps, around 65 and 190) from the actual
+///                   cubic S-curve, see tools/lib8bench, and it executes
 ///                   more than twice as fast.  Use when the cycles
 ///                   are more important than visual smoothness.
 ///                   Asm version takes around 7 cycles on AVR.
@@ -525,6 +581,34 @@ LIB8STATIC fract8 ease8InOutApprox(fract8 i)
     return i;
 }
 
+/// ease16InOutApprox: 16-bit version of ease8InOutApprox, the
+///                    same three straight lines with shifts and adds
+///                    only, for fades that need more than 256 steps.
+LIB8STATIC fract16 ease16InOutApprox(fract16 i)
+{
+    if (i < 0x4000)
+    {
+        // start with slope 0.5
+        i /= 2;
+    }
+    else if (i > (0xFFFF - 0x4000))
+    {
+        // end with slope 0.5
+        i = 0xFFFF - i;
+        i /= 2;
+        i = 0xFFFF - i;
+    }
+    else
+    {
+        // in the middle, use slope 1.5
+        i -= 0x4000;
+        i += (i / 2);
+        i += 0x2000;
+    }
+
+    return i;
+}
+
 /// triwave8: triangle (sawtooth) wave generator.  Useful for
 ///           turning a one-byte ever-increasing value into a
 ///           one-byte value that oscillates up and down.
@@ -594,6 +678,9 @@ LIB8STATIC uint8_t squarewave8(uint8_t in, uint8_t pulsewidth)
     return in < pulsewidth || pulsewidth == 255 ? 255 : 0;
 }
 
+// 1D value noise, after the easing and interpolation it's built from
+#include "lib8tion/noise8.h"
+
 // Beat generators - These functions produce waves at a given
 //                   number of 'beats per minute'.  Internally, they use
 //                   the Arduino function 'millis' to track elapsed time.
@@ -639,7 +726,11 @@ LIB8STATIC uint8_t squarewave8(uint8_t in, uint8_t pulsewidth)
 //
 //  The entire animation will now pulse between brightness 192 and 255 once per second.
 
+// Define GET_MILLIS() before including lib8tion to give the beat and
+// seconds functions a clock, without one they all read time as 1 ms.
+#ifndef GET_MILLIS
 #define GET_MILLIS() (1)
+#endif
 
 /// beat16 generates a 16-bit 'sawtooth' wave at a given BPM,
 ///        with BPM specified in Q8.8 fixed-point format; e.g.
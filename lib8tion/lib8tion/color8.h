@@ -0,0 +1,199 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2013 FastLED
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __INC_LIB8TION_COLOR_H
+#define __INC_LIB8TION_COLOR_H
+
+///@ingroup lib8tion
+
+///@defgroup Color Colour from a hue or a palette
+/// FastLED's hsv2rgb_rainbow() and ColorFromPalette() for a
+/// CRGBPalette16, cut down to plain bytes: the channels are written
+/// through pointers like nscale8x3(), so the caller puts them straight
+/// into its pixel in whatever order the LEDs want, and an effect only
+/// keeps the hue or palette index in RAM, not an RGB triple.
+///
+/// Palettes are 16 entries of r, g, b, 48 bytes, read with plain loads.
+/// The reduced core sees flash in its data space, so they can be
+/// PROGMEM there, elsewhere they have to be in RAM.
+///
+/// Cycles on AVRrc with LIB8_MULFREE, counted from the code
+/// (./build.sh lib8 measures them):
+///
+///   hsv2rgb_rainbow, sat and val 255   ~55, shifts and adds only
+///   each of sat, val below 255         +~260, scale8_video + 3 scale8
+///   color_from_palette16               ~20 on an entry, ~240 between
+///                                      two (3 blend8)
+///
+/// Flash: ~90 bytes for hsv2rgb_rainbow with the scale8 calls it makes
+/// below full saturation or value on top, ~24 bytes for the palette
+/// lookup plus blend8 and the palette itself.
+///@{
+
+/// Rainbow hue to RGB, FastLED's hsv2rgb_rainbow(): the hue wheel in 8
+/// sections of 32 with yellow given as much of it as the other colours,
+/// which looks more even on LEDs than the spectrum's. Saturation mixes
+/// in white, value dims through scale8_video(val, val), so both look
+/// roughly linear. At full saturation and value the sections' thirds
+/// and two-thirds are shift-adds, the same numbers scale8() gives.
+/// @param hue 0-255 around the wheel, 0 red, 64 yellow, 96 green,
+///            160 blue
+/// @param sat 0 white to 255 the pure hue
+/// @param val 0 off to 255 full
+LIB8STATIC void hsv2rgb_rainbow(uint8_t hue, uint8_t sat, uint8_t val, uint8_t *r, uint8_t *g, uint8_t *b)
+{
+    // scale8(offset << 3, 85) and scale8(offset << 3, 170) are
+    // offset * 43 >> 4 and offset * 171 >> 5, built from offset * 21
+    uint16_t offset = hue & 0x1f;
+    uint16_t x21 = (((offset << 2) + offset) << 2) + offset;
+    uint8_t third = ((x21 << 1) + offset) >> 4;                     // max 83
+    uint8_t twothirds = ((((x21 << 2) + offset) << 1) + offset) >> 5; // max 165
+    uint8_t rr, gg, bb;
+
+    if (!(hue & 0x80))
+    {
+        if (!(hue & 0x40))
+        {
+            if (!(hue & 0x20))
+            {
+                // red -> orange
+                rr = 255 - third;
+                gg = third;
+                bb = 0;
+            }
+            else
+            {
+                // orange -> yellow
+                rr = 171;
+                gg = 85 + third;
+                bb = 0;
+            }
+        }
+        else
+        {
+            if (!(hue & 0x20))
+            {
+                // yellow -> green
+                rr = 171 - twothirds;
+                gg = 170 + third;
+                bb = 0;
+            }
+            else
+            {
+                // green -> aqua
+                rr = 0;
+                gg = 255 - third;
+                bb = third;
+            }
+        }
+    }
+    else
+    {
+        if (!(hue & 0x40))
+        {
+            if (!(hue & 0x20))
+            {
+                // aqua -> blue
+                rr = 0;
+                gg = 171 - twothirds;
+                bb = 85 + twothirds;
+            }
+            else
+            {
+                // blue -> purple
+                rr = third;
+                gg = 0;
+                bb = 255 - third;
+            }
+        }
+        else
+        {
+            if (!(hue & 0x20))
+            {
+                // purple -> pink
+                rr = 85 + third;
+                gg = 0;
+                bb = 171 - third;
+            }
+            else
+            {
+                // pink -> red
+                rr = 170 + third;
+                gg = 0;
+                bb = 85 - third;
+            }
+        }
+    }
+
+    if (sat != 255)
+    {
+        // white floor under the scaled down hue, they add up to 255 at most
+        uint8_t desat = scale8_video(255 - sat, 255 - sat);
+        uint8_t satscale = 255 - desat;
+
+        rr = scale8(rr, satscale) + desat;
+        gg = scale8(gg, satscale) + desat;
+        bb = scale8(bb, satscale) + desat;
+    }
+
+    if (val != 255)
+    {
+        val = scale8_video(val, val);
+        rr = scale8(rr, val);
+        gg = scale8(gg, val);
+        bb = scale8(bb, val);
+    }
+
+    *r = rr;
+    *g = gg;
+    *b = bb;
+}
+
+/// Colour at index of a 16 entry palette, FastLED's ColorFromPalette()
+/// with LINEARBLEND: the top 4 bits pick the entry, the low 4 blend it
+/// towards the next one with blend8(), and entry 15 blends back into 0,
+/// so stepping index round and round cycles through the palette
+/// smoothly. Indexes that land on an entry cost no blend.
+/// @param palette 16 entries of r, g, b
+/// @param index 0-255 along the palette
+LIB8STATIC void color_from_palette16(const uint8_t *palette, uint8_t index, uint8_t *r, uint8_t *g, uint8_t *b)
+{
+    uint8_t i = index >> 4;
+    const uint8_t *entry = palette + (i << 1) + i;
+    uint8_t amount = index << 4;
+
+    *r = entry[0];
+    *g = entry[1];
+    *b = entry[2];
+    if (amount)
+    {
+        const uint8_t *next = index >= 0xf0 ? palette : entry + 3;
+
+        *r = blend8(*r, next[0], amount);
+        *g = blend8(*g, next[1], amount);
+        *b = blend8(*b, next[2], amount);
+    }
+}
+
+///@}
+#endif
@@ -0,0 +1,74 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2013 FastLED
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __INC_LIB8TION_NOISE_H
+#define __INC_LIB8TION_NOISE_H
+
+///@ingroup lib8tion
+
+///@defgroup Noise Fast 1D value noise
+/// Smooth random motion from a time counter, in the spirit of FastLED's
+/// 1D inoise8() but small enough for the reduced core: value noise
+/// instead of Perlin's gradients, and a hash instead of the 256 byte
+/// permutation table, so it costs no flash beyond its code and no RAM.
+///
+/// The noise takes a new random value at every multiple of 256 of x and
+/// eases between them, so it is band limited: nothing in it moves
+/// faster than one swing per 256 steps of x. Stepping x by more per
+/// frame makes it faster, adding a second call at a multiple of x
+/// (another octave) gives it finer detail.
+///
+/// Cycles on AVRrc with LIB8_MULFREE, counted from the code
+/// (./build.sh lib8 measures them): noise8_hash ~20, noise8 ~120, of
+/// which lerp8by8 is ~70. About 50 bytes of flash plus lerp8by8.
+///@{
+
+/// A random looking byte for lattice point i, the same every time.
+/// Multiplies by odd numbers as shift-adds and folds the high bits back
+/// down, so it is a permutation of 0..255 and neighbouring points are
+/// uncorrelated (lag-1 correlation -0.02 over the 256 points).
+LIB8STATIC uint8_t noise8_hash(uint8_t i)
+{
+    uint8_t h = i ^ 0xa5;
+
+    h += h << 3; // * 9
+    h ^= h >> 4;
+    h += h << 2; // * 5
+    h ^= h >> 3;
+    return h;
+}
+
+/// 1D value noise, 0-255: noise8_hash() of the lattice points either
+/// side of x (its high byte), blended across the low byte eased by
+/// ease8InOutApprox(), so it leaves every lattice point flat and there
+/// are no corners when the slope changes.
+/// @param x position, usually a time counter
+LIB8STATIC uint8_t noise8(uint16_t x)
+{
+    uint8_t i = x >> 8;
+
+    return lerp8by8(noise8_hash(i), noise8_hash(i + 1), ease8InOutApprox(x));
+}
+
+///@}
+#endif
@@ -35,7 +35,12 @@
 #define FASTLED_RAND16_2053  ((uint16_t)(2053))
 #define FASTLED_RAND16_13849 ((uint16_t)(13849))
 
+#if LIB8_MULFREE
+// 2053 == 2048 + 4 + 1
+#define APPLY_FASTLED_RAND16_2053(x) ((uint16_t)((x) + ((x) << 2) + ((x) << 11)))
+#else
 #define APPLY_FASTLED_RAND16_2053(x) (x * FASTLED_RAND16_2053)
+#endif
 
 /// random number seed
 extern uint16_t rand16seed; // = RAND16_SEED;
@@ -61,7 +66,11 @@ LIB8STATIC uint16_t random16()
 LIB8STATIC uint8_t random8_to(uint8_t lim)
 {
     uint8_t r = random8();
+#if LIB8_MULFREE
+    r = mul8by8(r, lim) >> 8;
+#else
     r = (r * lim) >> 8;
+#endif
     return r;
 }
 
@@ -40,9 +40,15 @@
 ///  the numerator of a fraction whose denominator is 256
 ///  In other words, it computes i * (scale / 256)
 ///  4 clocks AVR with MUL, 2 clocks ARM
+///  LIB8_MULFREE: 62 clocks AVRrc, shift-and-add through mul8by8
 LIB8STATIC_ALWAYS_INLINE uint8_t scale8(uint8_t i, fract8 scale)
 {
+#if LIB8_MULFREE
+    // i * (scale + 1) == i * scale + i, without the 9-bit scale + 1
+    return (mul8by8(i, scale) + i) >> 8;
+#else
     return (((uint16_t) i) * (1 + (uint16_t) (scale))) >> 8;
+#endif
 }
 
 ///  The "video" version of scale8 guarantees that the output will
@@ -52,7 +58,11 @@ LIB8STATIC_ALWAYS_INLINE uint8_t scale8(uint8_t i, fract8 scale)
 ///  several additional cycles.
 LIB8STATIC_ALWAYS_INLINE uint8_t scale8_video(uint8_t i, fract8 scale)
 {
+#if LIB8_MULFREE
+    return (mul8by8(i, scale) >> 8) + ((i && scale) ? 1 : 0);
+#else
     return (((int) i * (int) scale) >> 8) + ((i && scale) ? 1 : 0);
+#endif
 }
 
 /// scale three one byte values by a fourth one, which is treated as
@@ -62,10 +72,16 @@ LIB8STATIC_ALWAYS_INLINE uint8_t scale8_video(uint8_t i, fract8 scale)
 ///         THIS FUNCTION ALWAYS MODIFIES ITS ARGUMENTS IN PLACE
 LIB8STATIC void nscale8x3(uint8_t *r, uint8_t *g, uint8_t *b, fract8 scale)
 {
+#if LIB8_MULFREE
+    *r = scale8(*r, scale);
+    *g = scale8(*g, scale);
+    *b = scale8(*b, scale);
+#else
     uint16_t scale_fixed = scale + 1;
     *r = (((uint16_t) *r) * scale_fixed) >> 8;
     *g = (((uint16_t) *g) * scale_fixed) >> 8;
     *b = (((uint16_t) *b) * scale_fixed) >> 8;
+#endif
 }
 
 /// scale three one byte values by a fourth one, which is treated as
@@ -77,10 +93,16 @@ LIB8STATIC void nscale8x3(uint8_t *r, uint8_t *g, uint8_t *b, fract8 scale)
 ///         THIS FUNCTION ALWAYS MODIFIES ITS ARGUMENTS IN PLACE
 LIB8STATIC void nscale8x3_video(uint8_t *r, uint8_t *g, uint8_t *b, fract8 scale)
 {
+#if LIB8_MULFREE
+    *r = scale8_video(*r, scale);
+    *g = scale8_video(*g, scale);
+    *b = scale8_video(*b, scale);
+#else
     uint8_t nonzeroscale = (scale != 0) ? 1 : 0;
     *r = (*r == 0) ? 0 : (((int) *r * (int) (scale)) >> 8) + nonzeroscale;
     *g = (*g == 0) ? 0 : (((int) *g * (int) (scale)) >> 8) + nonzeroscale;
     *b = (*b == 0) ? 0 : (((int) *b * (int) (scale)) >> 8) + nonzeroscale;
+#endif
 }
 
 ///  scale two one byte values by a third one, which is treated as
@@ -90,9 +112,14 @@ LIB8STATIC void nscale8x3_video(uint8_t *r, uint8_t *g, uint8_t *b, fract8 scale
 ///         THIS FUNCTION ALWAYS MODIFIES ITS ARGUMENTS IN PLACE
 LIB8STATIC void nscale8x2(uint8_t *i, uint8_t *j, fract8 scale)
 {
+#if LIB8_MULFREE
+    *i = scale8(*i, scale);
+    *j = scale8(*j, scale);
+#else
     uint16_t scale_fixed = scale + 1;
     *i = (((uint16_t) *i) * scale_fixed) >> 8;
     *j = (((uint16_t) *j) * scale_fixed) >> 8;
+#endif
 }
 
 ///  scale two one byte values by a third one, which is treated as
@@ -104,9 +131,14 @@ LIB8STATIC void nscale8x2(uint8_t *i, uint8_t *j, fract8 scale)
 ///         THIS FUNCTION ALWAYS MODIFIES ITS ARGUMENTS IN PLACE
 LIB8STATIC void nscale8x2_video(uint8_t *i, uint8_t *j, fract8 scale)
 {
+#if LIB8_MULFREE
+    *i = scale8_video(*i, scale);
+    *j = scale8_video(*j, scale);
+#else
     uint8_t nonzeroscale = (scale != 0) ? 1 : 0;
     *i = (*i == 0) ? 0 : (((int) *i * (int) (scale)) >> 8) + nonzeroscale;
     *j = (*j == 0) ? 0 : (((int) *j * (int) (scale)) >> 8) + nonzeroscale;
+#endif
 }
 
 /// scale a 16-bit unsigned value by an 8-bit value,
@@ -114,7 +146,20 @@ LIB8STATIC void nscale8x2_video(uint8_t *i, uint8_t *j, fract8 scale)
 ///         is 256. In other words, it computes i * (scale / 256)
 LIB8STATIC_ALWAYS_INLINE uint16_t scale16by8(uint16_t i, fract8 scale)
 {
-    return (i * (1 + ((uint16_t) scale))) >> 8;
+#if LIB8_MULFREE
+    // i * scale + i, a byte at a time, keeping the carry of the low half
+    uint16_t low = mul8by8(i & 0xFF, scale);
+    uint16_t sum = low + i;
+    uint16_t result = mul8by8(i >> 8, scale) + (sum >> 8);
+    if (sum < low)
+    {
+        result += 0x100;
+    }
+    return result;
+#else
+    // 16x16 would overflow where int is 16 bits
+    return ((uint32_t) i * (1 + ((uint16_t) scale))) >> 8;
+#endif
 }
 
 /// scale a 16-bit unsigned value by a 16-bit value,
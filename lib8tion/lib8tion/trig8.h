@@ -59,7 +59,11 @@ LIB8STATIC int16_t sin16(uint16_t theta)
 
     uint8_t secoffset8 = (uint8_t)(offset) / 2;
 
+#if LIB8_MULFREE
+    uint16_t mx = mul8by8(m, secoffset8);
+#else
     uint16_t mx = m * secoffset8;
+#endif
     int16_t y = mx + b;
 
     if (theta & 0x8000)
@@ -127,7 +131,11 @@ LIB8STATIC uint8_t sin8(uint8_t theta)
     ++p;
     uint8_t m16 = *p;
 
+#if LIB8_MULFREE
+    uint8_t mx = mul8by8(m16, secoffset) >> 4;
+#else
     uint8_t mx = (m16 * secoffset) >> 4;
+#endif
 
     int8_t y = mx + b;
     if (theta & 0x80)
@@ -1,22 +1,117 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+// lib8tion's beat and seconds functions run off millis, which
+// nap_periods() keeps
+extern uint32_t millis;
+#define GET_MILLIS() (millis)
 
 #include "lib8tion/lib8tion.h"
+#include "pt.h"
+#include "tinyrand.h"
 
 
+// Pick one effect here, or on the command line with e.g. -DFLICKER=1
+#if !defined(BREATHE) && !defined(FLICKER) && !defined(SIREN) && !defined(MORSE) && !defined(PATTERN)
 #define BREATHE 1
 // #define FLICKER 1
 // #define SIREN 1
 // #define MORSE 1
+// #define PATTERN 1 // bytecode, several patterns switch by covering the sensor
+#endif
 
 // Embed source link in hex
 const uint8_t volatile pilate[] = "github.com/Pilate";
 
-uint8_t led_color[3] = {0x00, 0x00, 0x00};
+// Number of SK6803 pixels on the data line, all showing the same
+// colour (see led_set()). Every pixel costs 3 bytes
+// of SRAM in led_color, and the ATtiny5 only has 32: the scheduler,
+// clock, ambient tracker and tiny_rand() take 14, an effect's own state
+// up to 6 (PATTERN) and the deepest stack about 8, which leaves room for
+// 2 pixels and not 3. PATTERN with 2 is on the edge, build.sh's SRAM
+// check measures every image and fails the ones that don't fit.
+#ifndef LED_COUNT
+#define LED_COUNT 1
+#endif
+
+#if LED_COUNT < 1 || LED_COUNT > 2
+#error "LED_COUNT must be 1 or 2"
+#endif
+
+uint8_t led_color[LED_COUNT * 3];
+
+// Clock domains. update_led() needs the full 8 MHz for the SK6803's bit
+// timing, everything else (effect math, the scheduler, ADC handling and
+// the return from a watchdog wakeup) can run with CLKPSR = CLK_SLOW,
+// i.e. at 8 MHz >> CLK_SLOW, and led_show() switches up just around the
+// burst. The watchdog runs off its own 128 kHz oscillator, so only the
+// ADC prescaler (kept at a 125 kHz ADC clock) follows CLK_SLOW.
+//
+// This lowers the peak current, which is what a coin cell's internal
+// resistance cares about, but not the energy: the 8 MHz oscillator runs
+// whatever the prescaler, so each slow cycle costs more than a fast one.
+// Hence 0 by default.
+#ifndef CLK_SLOW
+#define CLK_SLOW 0
+#endif
+
+#if CLK_SLOW < 0 || CLK_SLOW > 5
+#error "CLK_SLOW must be between 0 (8 MHz) and 5 (250 kHz)"
+#endif
+
+void clock_set(uint8_t clkps)
+{
+    CCP = 0xD8;
+    CLKPSR = clkps;
+}
+
+// Power. Out of reset Timer0 and the ADC are clocked and the analog
+// comparator is on, and the comparator draws current in every sleep mode.
+// power_init() switches the comparator off for good, gates both clocks
+// through PRR, and adc_sample() ungates the ADC only for its reading. The
+// pins stay in their sleep state whenever the core sleeps:
+//
+//   PB0  input, no pull-up, digital buffer off: the divider's bottom
+//        resistor holds it at GND, so nothing floats or leaks
+//   PB1  output low: the divider is unpowered, high only in adc_sample()
+//        (and in nap_dark() with LIGHT_WAKE)
+//   PB2  output low: SK6803 data idles low, no current into its input
+//   PB3  RESET, the internal pull-up keeps it high
+//
+// Sleep current at 3 V, typical datasheet figures plus the divider:
+//
+//   power down, watchdog on (nap_periods)       4.5 uA
+//   power down, watchdog off (LIGHT_WAKE)       0.15 uA + 3 V / divider R
+//   ADC noise reduction, converting             ~0.3 mA for ~0.2 ms
+//   comparator left on, in any of the above     +~25 uA
+//
+// so a throwie that is dark all night sits at about 4.5 uA between frames,
+// where it was about 30 uA with the comparator on.
+#define POWER_OFF ((1 << PRTIM0) | (1 << PRADC))
+#define POWER_ADC (1 << PRTIM0)
+
+void power_init()
+{
+    ACSR = (1 << ACD); // analog comparator off
+    PRR = POWER_OFF;
+
+    // PB0 used for photoresistor input
+    DDRB = 0b1110;
+    PORTB = 0b0000;
+
+    // Digital input disable on ADC pins
+    DIDR0 = (1 << ADC0D) | (1 << ADC1D);
+}
 
 void update_led()
 {
+#ifdef HOST
+    // tools/host: the frame goes to the CSV instead
+    host_frame(led_color, sizeof(led_color));
+#else
     /*
     8 MHz - 125ns (0.125us)
 
@@ -29,19 +124,22 @@ void update_led()
       - 0.625 HIGH (5 cycles)
       - 0.625 LOW (5 cycles)
 
+    Every bit is exactly 10 cycles, including the last bit of each byte:
+    the byte fetch and counters are done in the slots bitloop spends on
+    nop/rjmp, so there is no extra gap between bytes or pixels and the
+    whole chain is sent with the same timing.
+
     Interrupts should be disabled
     */
 
+    uint8_t *data = led_color;
+
     asm volatile(
         "setup: "
-        " cli \n"        // disable interrupts, timing has to be perfect
-        " ldi r21, 3 \n" // number of bytes to send
-        
-        "start: "
-        " dec r21 \n"
-        " brmi end \n"
-        " ld r22, X+ \n" // Load next byte
-        " ldi r23, 8 \n" // set bit counter to 8
+        " cli \n"             // disable interrupts, timing has to be perfect
+        " ldi r21, %[len] \n" // number of bytes to send
+        " ldi r23, 7 \n"      // bits 7..1 go through bitloop
+        " ld r22, X+ \n"      // Load first byte
 
         "bitloop: "
         " sbi %[port], 2 \n" // Set pin to HIGH
@@ -54,37 +152,244 @@ void update_led()
 
         "endlow: "
         " cbi %[port], 2 \n" // Shared LOW
-        " breq start \n"     // if bit counter was 0, back to start
+        " breq lastbit \n"   // if bit counter was 0, send the last bit
         " nop \n"
         " rjmp bitloop \n"
 
+        // Same shape as bitloop, the 2 cycles taken by breq and the nop
+        // are used to fetch the next byte and reset the bit counter
+        "lastbit: "
+        " ldi r23, 7 \n"     // reset bit counter
+        " ld r24, X+ \n"     // Load next byte (reads one past the end on the last byte)
+        " sbi %[port], 2 \n" // Set pin to HIGH
+        " lsl r22 \n"        // Shift the last bit into C flag
+        " brcs lasthigh \n"  // Stay high on 1 bit
+        " cbi %[port], 2 \n" // Send 0 bit
+
+        "lasthigh: "
+        " mov r22, r24 \n"   // next byte becomes current, doesn't touch flags
+
+        "lastlow: "
+        " cbi %[port], 2 \n" // Shared LOW
+        " nop \n"
+        " dec r21 \n"        // decrease byte counter
+        " brne bitloop \n"   // more bytes, back to the first bit
+
         "end:"
-        :
+        : [data] "+x"(data)
         : [port] "I"(_SFR_IO_ADDR(PORTB)),
-          [data] "x"(led_color)
-        : "r21", "r22", "r23", "cc", "memory");
+          [len] "M"(LED_COUNT * 3)
+        : "r21", "r22", "r23", "r24", "cc", "memory");
+#endif
+}
+
+// Output layer. Effects write a channel, 0 green, 1 red, 2 blue, with
+// led_set(), which puts it in every pixel of led_color, so the effects
+// don't care what LED_COUNT is. It sets LED_DIRTY when the channel
+// changes and led_show() clears it, so led_changed() can tell when a
+// frame would change nothing without a copy of what the LEDs show. The
+// pixels always match, so pixel 0 says whether it changed. The flag is
+// a spare bit of the ambient tracker's state byte. Build with LED_SKIP 0
+// to send every frame, e.g. to compare update_led calls with avrsim -f
+// update_led.
+#ifndef LED_SKIP
+#define LED_SKIP 1
+#endif
+
+#define LED_DIRTY 0x40
+extern uint8_t ambient_state;
+
+void led_set(uint8_t channel, uint8_t value)
+{
+    if (led_color[channel] != value)
+    {
+        for (uint8_t i = channel; i < sizeof(led_color); i += 3)
+        {
+            led_color[i] = value;
+        }
+        ambient_state |= LED_DIRTY;
+    }
+}
+
+uint8_t led_changed()
+{
+    return !LED_SKIP || ambient_state & LED_DIRTY;
+}
+
+void led_show()
+{
+    ambient_state &= ~LED_DIRTY;
+#if CLK_SLOW
+    clock_set(0);
+    update_led();
+    clock_set(CLK_SLOW);
+#else
+    update_led();
+#endif
 }
 
-void nap(uint16_t nap_time)
+// Quantise an 8.8 fixed point channel to the SK6803's 8 bits, spreading
+// the fraction over 4 frames by phase: it gets rounded up on 0 to 4 of
+// every 4 frames, with the thresholds in bit reversed order so the extra
+// count flickers as fast as possible. No state, phase just has to step
+// once a frame.
+uint8_t dither8(uint16_t value, uint8_t phase)
 {
-    uint16_t timeout;
-    uint8_t wdp;
+    uint8_t threshold = 0x20 | (phase & 1) << 7 | (phase & 2) << 5;
+    uint16_t dithered = value + threshold;
+
+    if (dithered < value)
+    {
+        return 0xff;
+    }
+    return dithered >> 8;
+}
 
-    asm volatile("sei");
+// Longest a run of unchanged frames goes without returning to the
+// scheduler, so a frame that never changes can't spin forever
+#define FRAME_WAIT_MAX (2048 / PT_TICK_MS)
+
+// Show led_color and hold it for ticks PT_TICK_MS periods. A frame that
+// changes nothing isn't sent and doesn't sleep either: its time is added
+// to the task's sleep, which is 0 while it runs, and slept in one go
+// before the next frame that does change something, so a run of
+// identical frames costs one wakeup instead of one each and no RAM.
+// That sleep stays below 0xffff as long as ticks is at most 0xffff -
+// FRAME_WAIT_MAX.
+#define PT_SHOW_TICKS(pt, ticks)                                                \
+    do                                                                          \
+    {                                                                           \
+        if ((pt)->sleep && (led_changed() || (pt)->sleep >= FRAME_WAIT_MAX))    \
+        {                                                                       \
+            uint16_t wait = (pt)->sleep;                                        \
+            (pt)->sleep = 0;                                                    \
+            PT_SLEEP_TICKS(pt, wait);                                           \
+        }                                                                       \
+        if (led_changed())                                                      \
+        {                                                                       \
+            led_show();                                                         \
+        }                                                                       \
+        (pt)->sleep += (ticks);                                                 \
+    } while (0)
+
+// Same in ms, rounded down to whole watchdog periods
+#define PT_SHOW(pt, ms) PT_SHOW_TICKS(pt, (ms) / PT_TICK_MS)
+
+// The ease BREATHE and PATTERN's ramps run their brightness through,
+// 0-0xffff in and out. EASE_CURVE picks compute or table:
+//
+//   0  lib8tion's ease16InOutApprox(), three straight lines, no flash
+//      beyond the code, up to 3.13% off the cubic S-curve
+//   1  the cubic S-curve from ease_table, up to 0.62% off (1.58 steps
+//      of 255) with the default 17 points (34 bytes)
+//   2  the exp(sin) breath from breath_table, softer at the dark end,
+//      up to 0.92% off with 17 points
+//
+// The tables are made by tools/curves (build.sh, sized with CURVES) and
+// read by curve16(). ./build.sh lib8 has the cycles, flash and error of
+// each, the build log the error for the table sizes chosen.
+#ifndef EASE_CURVE
+#define EASE_CURVE 0
+#endif
+
+// The SK6803's duty is linear in the byte sent, the eye isn't: it sees
+// most of the difference in the bottom quarter, so a breath linear in
+// duty looks nearly fully lit for most of its length and changes in
+// visible steps at the dark end. LED_GAMMA 1 runs the 8.8 brightness
+// BREATHE and PATTERN show through x^2.2 from gamma_table (34 bytes, up
+// to 0.83% off as ./build.sh lib8 measures it) before it is scaled by
+// the colour and dithered, so equal steps in brightness look equal. One
+// lookup a frame, no multiply, and the colour keeps its hue as only the
+// brightness is bent. Effects that send bytes they chose by hand
+// (FLICKER, SIREN, MORSE) don't use it.
+#ifndef LED_GAMMA
+#define LED_GAMMA 0
+#endif
+
+#if EASE_CURVE || LED_GAMMA
+#include "curve.h"
+#include "curves.h"
+#endif
+
+static inline uint16_t led_gamma(uint16_t brightness)
+{
+#if LED_GAMMA
+    return curve16(gamma_table, brightness, GAMMA_TABLE_BITS);
+#else
+    return brightness;
+#endif
+}
+
+static inline uint16_t ease_curve(uint16_t x)
+{
+#if EASE_CURVE == 2
+    return curve16(breath_table, x, BREATH_TABLE_BITS);
+#elif EASE_CURVE
+    return curve16(ease_table, x, EASE_TABLE_BITS);
+#else
+    return ease16InOutApprox(x);
+#endif
+}
+
+// Milliseconds since reset. There is no timer running in power down, so
+// nap_periods() adds up the watchdog periods it slept. The time awake
+// between them isn't counted: about 0.1 ms a wakeup at 8 MHz (avrsim's
+// cycles awake per wakeup, twice that per step of CLK_SLOW), so millis
+// runs up to 0.6% slow for an effect that wakes every 16 ms frame and
+// far less for the rest. That is inside the watchdog oscillator's own
+// tolerance and accepted rather than spending RAM to carry it.
+uint32_t millis;
+
+// Sleep count watchdog periods of 16 ms << wdp, wdp 0-9 (16 ms to 8 s)
+void nap_periods(uint8_t wdp, uint8_t count)
+{
+    uint8_t wdtcsr = (1 << WDIE) | (wdp & 7); // Watchdog interrupt enable
+    uint16_t period = 16 << wdp;
+
+    // 4 and 8 seconds, WDP3 isn't next to the other prescaler bits
+    if (wdp & 8)
+    {
+        wdtcsr |= 1 << WDP3;
+    }
+
+    sei();
 
     SMCR = (1 << SM1) | // Sleep mode: power down
            (1 << SE);   // Sleep mode enable
 
-    // doing wdp higher than 7 requires setting the wdp3 bit separately
-    for (timeout = 2048, wdp = 7; timeout >= 16; timeout /= 2, wdp--)
+    // The prescaler stays set between naps and most reuse it, so only
+    // unlock and write it when it changes
+    if (WDTCSR != wdtcsr)
     {
         CCP = 0xD8;
-        WDTCSR = wdp | (1 << WDIE); // Watchdog interrupt enable
+        WDTCSR = wdtcsr;
+    }
 
-        while (nap_time >= timeout)
+    wdt_reset(); // every period slept is then a whole one
+
+    do
+    {
+        sleep_cpu();
+        millis += period;
+    } while (--count);
+}
+
+// Sleep for nap_time rounded down to 16 ms, with one wakeup per set bit
+// of nap_time / 16 and one per 8 s above 4 s
+void nap_plan(uint16_t nap_time)
+{
+    uint16_t units = nap_time >> 4;
+
+    for (uint8_t wdp = 0; units; wdp++, units >>= 1)
+    {
+        if (wdp == 9)
         {
-            asm volatile("sleep");
-            nap_time -= timeout;
+            nap_periods(9, units);
+            break;
+        }
+        if (units & 1)
+        {
+            nap_periods(wdp, 1);
         }
     }
 }
@@ -92,88 +397,317 @@ void nap(uint16_t nap_time)
 // Watchdog
 ISR(WDT_vect, ISR_NAKED)
 {
-    asm volatile("reti");
+    reti();
 }
 
 // ADC
 ISR(ADC_vect, ISR_NAKED)
 {
-    asm volatile("reti");
+    reti();
 }
 
-// Claude *magic* RNG
-uint8_t tiny_rand(void)
+// adc_sample() calls at power on that only seed tiny_rand()
+#ifndef RAND_SEED_READINGS
+#define RAND_SEED_READINGS 16
+#endif
+
+// ADC clock divider for 125 kHz at 8 MHz >> CLK_SLOW, /64 at full speed
+#define ADC_PRESCALE (6 - CLK_SLOW)
+
+// Light level on PB0 in 1/4 ADC counts (0-1020), higher is darker.
+// Every reading is stirred into tiny_rand()'s state as well.
+//
+// By default that's a single conversion. With ADC_BURST set to 4, 8 or
+// 16 the ADC free runs instead: one ADSC starts ADC_SETTLE conversions
+// that are thrown away while the divider settles, then ADC_BURST that
+// are summed, with the core back in noise reduction sleep between each
+// one. The sum is decimated to the same 1/4 count scale, 16 conversions
+// give 2 more real bits than one, 4 give 1, as long as the reading has
+// about a count of noise on it to average out.
+//
+// PB1 powers the divider only for the burst. The first conversion
+// takes 25 ADC clocks and samples 13.5 clocks in, 108 us after ADEN at
+// the /64 prescaler, which is already 5 RC for a 1 MOhm photoresistor
+// into the ~15 pF of pin and sample capacitor, so ADC_SETTLE 1 is
+// there for slower dividers and 0 gives the shortest on-time.
+#ifdef ADC_BURST
+
+#if ADC_BURST != 4 && ADC_BURST != 8 && ADC_BURST != 16
+#error "ADC_BURST must be 4, 8 or 16"
+#endif
+
+#ifndef ADC_SETTLE
+#define ADC_SETTLE 1
+#endif
+
+uint16_t adc_sample()
 {
-    static uint8_t lfsr = 1;
+    uint16_t sum = 0;
+    int8_t n = -ADC_SETTLE;
+
+    PORTB |= (1 << PORTB1);
+
+    PRR = POWER_ADC;
 
-    uint8_t bit = lfsr & 1;
-    lfsr >>= 1;
-    if (bit)
+    // ADCSRB is 0 out of reset, free running auto trigger
+    ADCSRA = (1 << ADEN) |  // Enable ADC
+             (1 << ADSC) |  // Start the first conversion
+             (1 << ADATE) | // and keep converting
+             (1 << ADIE) |  // Enable completion interrupt
+             ADC_PRESCALE;  // 125 kHz ADC clock
+
+    sei();
+
+    SMCR = (1 << SM0) | // Sleep mode: ADC Noise reduction
+           (1 << SE);   // Sleep enable
+
+    do
     {
-        lfsr ^= 0xB4;
-    }
-    return lfsr;
+        sleep_cpu();
+        if (n >= 0)
+        {
+            sum += ADCL;
+        }
+    } while (++n < ADC_BURST);
+
+    PORTB &= ~(1 << PORTB1);
+    ADCSRA = 0;
+    PRR = POWER_OFF; // only once ADEN is clear
+
+    rand_stir(sum);
+    return sum / (ADC_BURST / 4);
 }
 
-uint8_t adc_sample()
+#else
+
+uint16_t adc_sample()
 {
-    asm volatile("sbi %[port], 1" ::[port] "m"(PORTB));
+    PORTB |= (1 << PORTB1);
+    PRR = POWER_ADC;
 
     ADCSRA = (1 << ADEN) |  // Enable ADC
              (1 << ADIE) |  // Enable completion interrupt
-             (1 << ADPS2) | // Set prescaler to 64
-             (1 << ADPS1);
+             ADC_PRESCALE;  // 125 kHz ADC clock
 
-    asm volatile("sei");
+    sei();
 
     SMCR = (1 << SM0) | // Sleep mode: ADC Noise reduction
            (1 << SE);   // Sleep enable
-    asm volatile("sleep");
+    sleep_cpu();
 
     uint8_t result = ADCL;
 
-    asm volatile("cbi %[port], 1" ::[port] "m"(PORTB));
+    PORTB &= ~(1 << PORTB1);
     ADCSRA = 0;
+    PRR = POWER_OFF; // only once ADEN is clear
 
-    return result;
+    rand_stir(result);
+    return result << 2;
 }
 
+#endif
+
+// Ambient light, shared by every effect. adc_sample() goes through an
+// exponential moving average (1/4 new reading, 8.8 fixed point, so the
+// fraction keeps ADC_BURST's extra bits), with separate dark and light
+// thresholds so dusk doesn't flap the effect on and off. While it's
+// light, nap_dark() looks again after a watchdog period that doubles
+// every steady reading, from AMBIENT_POLL_MIN to AMBIENT_POLL_MAX, and
+// drops back to the shortest near the thresholds or when the reading
+// jumps.
+#ifndef AMBIENT_DARK
+#define AMBIENT_DARK 108 // dark at or above, higher reading is darker
+#endif
+#ifndef AMBIENT_LIGHT
+#define AMBIENT_LIGHT 92 // light again at or below
+#endif
+#define AMBIENT_NEAR 16    // poll fast this close to a threshold
+#define AMBIENT_POLL_MIN 5 // 512 ms
+#define AMBIENT_POLL_MAX 9 // 8 s
+
+uint16_t ambient;
+// bit 7 dark, bit 6 LED_DIRTY for the output layer, bits 5..4 the light
+// task's gesture checks left (see GESTURE_CHECKS), bits 3..0 watchdog
+// prescaler to poll with
+uint8_t ambient_state;
+
+uint8_t ambient_dark()
+{
+    uint16_t reading = adc_sample();
+    uint8_t sample = reading >> 2;
+
+    if (!ambient)
+    {
+        ambient = reading << 6; // first reading
+    }
+    ambient = ambient - (ambient >> 2) + (reading << 4);
+
+    uint8_t level = ambient >> 8;
+    uint8_t dark = ambient_state & 0x80;
+    uint8_t wdp = ambient_state & 0x0f;
+
+    if (level >= AMBIENT_DARK)
+    {
+        dark = 0x80;
+    }
+    else if (level <= AMBIENT_LIGHT)
+    {
+        dark = 0;
+    }
+
+    uint8_t jump = sample > level ? sample - level : level - sample;
+    if (jump > AMBIENT_NEAR ||
+        (level > AMBIENT_LIGHT - AMBIENT_NEAR && level < AMBIENT_DARK + AMBIENT_NEAR) ||
+        wdp < AMBIENT_POLL_MIN)
+    {
+        wdp = AMBIENT_POLL_MIN;
+    }
+    else if (wdp < AMBIENT_POLL_MAX)
+    {
+        wdp++;
+    }
+
+    ambient_state = (ambient_state & 0x70) | dark | wdp;
+    return dark;
+}
+
+// Sleep while it's light until it may have got dark. The ATtiny5's
+// analog comparator only compares PB0 with PB1, which is the divider's
+// supply, and can't wake from power down, so with LIGHT_WAKE this uses
+// the pin change interrupt on PB0 instead: the divider stays powered and
+// the core sleeps until PB0 crosses its input threshold (0.3-0.6 VCC),
+// which removes the polling lag. That threshold can be darker than
+// AMBIENT_DARK, so the watchdog stays on at AMBIENT_POLL_MAX to catch a
+// dusk that stops in between, which costs its current but only one
+// wakeup per 8 s. The divider draws VCC / R all the time, so it only
+// saves current with a divider of a few MOhm. millis counts a pin change
+// wakeup as a whole watchdog period.
+#ifdef LIGHT_WAKE
+
+// Photoresistor pin change
+ISR(PCINT0_vect, ISR_NAKED)
+{
+    reti();
+}
+
+void nap_dark()
+{
+    PORTB |= (1 << PORTB1);
+    DIDR0 = (1 << ADC1D); // PB0 digital input on
+
+    // Between the ADC's threshold and the pin's, only a rising edge
+    // would wake, so poll as usual
+    if (PINB & (1 << PINB0))
+    {
+        PORTB &= ~(1 << PORTB1);
+        DIDR0 = (1 << ADC0D) | (1 << ADC1D);
+        nap_periods(ambient_state & 0x0f, 1);
+        return;
+    }
+
+    PCMSK = (1 << PCINT0);
+    PCICR = (1 << PCIE0);
+
+    nap_periods(AMBIENT_POLL_MAX, 1);
+
+    PCICR = 0;
+    PCMSK = 0;
+    PORTB &= ~(1 << PORTB1);
+    DIDR0 = (1 << ADC0D) | (1 << ADC1D);
+}
+
+#else
+
+// Look again after the ambient tracker's polling interval
+static inline __attribute__((always_inline)) void nap_dark()
+{
+    nap_periods(ambient_state & 0x0f, 1);
+}
+
+#endif
+
 #ifdef BREATHE
 
-uint8_t rand_color[3] = {0x00, 0x00, 0x00};
-uint8_t scale[4] = {0x00, 0x55, 0xaa, 0xff};
+// Show every BREATHE_STEP'th step of the breath for BREATHE_STEP times as
+// long, 1, 2 or 4. With LED_GAMMA the steps are even to the eye and half
+// as many look as smooth, so a breath takes half the wakeups.
+#ifndef BREATHE_STEP
+#define BREATHE_STEP (LED_GAMMA ? 2 : 1)
+#endif
+
+#if BREATHE_STEP != 1 && BREATHE_STEP != 2 && BREATHE_STEP != 4
+#error "BREATHE_STEP must be 1, 2 or 4"
+#endif
+
+// What the random byte each run of breaths picks, rand_color, turns into:
+//
+//   0  2 bits per channel from scale, 64 colours, a few of them harsh
+//   1  a hue for lib8tion's hsv2rgb_rainbow() at full saturation, ~55
+//      cycles a frame
+//   2  a point along palette.h's party_palette, blended between its 16
+//      entries, ~240 cycles a frame and 48 bytes of flash
+//
+// The colour is worked out again from the byte every frame, so 1 and 2
+// don't keep an RGB triple in SRAM either.
+#ifndef BREATHE_COLOR
+#define BREATHE_COLOR 0
+#endif
 
-void dim(uint8_t divider)
+uint8_t rand_color;
+
+#if BREATHE_COLOR == 2
+#include "palette.h"
+#elif !BREATHE_COLOR
+const uint8_t scale[4] = {0x00, 0x55, 0xaa, 0xff};
+#endif
+
+// Brightness and channels in 8.8 fixed point, dithered down to 8 bits,
+// so the dark end of a breath fades in quarter steps and a 0x55 channel
+// doesn't drop out while the others are still lit. About 450 cycles on
+// the reduced core (two mul8by8 per channel), well inside a 16 ms frame.
+void dim(uint16_t brightness, uint8_t phase)
 {
+#if BREATHE_COLOR
+    uint8_t color[3]; // g r b like led_color
+#if BREATHE_COLOR == 2
+    color_from_palette16(party_palette, rand_color, &color[1], &color[0], &color[2]);
+#else
+    hsv2rgb_rainbow(rand_color, 255, 255, &color[1], &color[0], &color[2]);
+#endif
+#else
+    uint8_t color = rand_color;
+#endif
+
+    brightness = led_gamma(brightness);
     for (uint8_t i = 0; i < 3; i++)
     {
-        led_color[i] = scale8(rand_color[i], divider);
+#if BREATHE_COLOR
+        uint8_t channel = color[i];
+#else
+        uint8_t channel = scale[color & 0b11];
+        color >>= 2;
+#endif
+        led_set(i, channel ? dither8(scale16by8(brightness, channel), phase) : 0);
     }
 }
 
-void effect()
+void effect(pt_t *pt)
 {
-    while (1)
-    {
-        uint8_t byte = tiny_rand();
+    static uint8_t loops;
+    static uint8_t counter;
+    static int8_t direction;
 
-        for (uint8_t i = 0; i < 3; i++)
-        {
-            rand_color[i] = scale[byte & 0b11];
-            byte >>= 2;
-        }
+    PT_BEGIN(pt);
 
-        while (adc_sample() < 100)
-        {
-            // nap(0xf000); // 60 seconds
-            nap(10240);
-        }
+    while (1)
+    {
+        rand_color = tiny_rand();
 
-        uint8_t loops = 3;
+        loops = 3;
         while (loops--)
         {
-            uint8_t counter = 1;
-            int8_t direction = 1;
+            counter = 1;
+            direction = 1;
 
             while (counter)
             {
@@ -182,209 +716,407 @@ void effect()
                 {
                     direction = -1;
                 }
+                if (counter & (BREATHE_STEP - 1))
+                {
+                    continue;
+                }
 
-                dim(ease8InOutApprox(counter));
-                update_led();
-                nap(16);
+                dim(ease_curve(counter << 8), counter / BREATHE_STEP);
+                PT_SHOW(pt, 16 * BREATHE_STEP);
             }
 
-            nap(512);
+            PT_SHOW(pt, 512);
         }
     }
+
+    PT_END(pt);
 }
 
 #elif FLICKER
 
-void effect()
+// A candle: lib8tion's noise8() for the flame's slow sway, a new value
+// about every second, plus a second octave twice as fast for the
+// flutter, on a warm red. The noise is smooth, so a frame every 256 ms
+// reads as motion, where the old random steps of 64 ms still looked
+// digital. Every frame changes, but with a quarter of the frames and a
+// power of two watchdog period each, a night takes fewer wakeups than
+// the old steps did. ~250 cycles a frame, no multiply outside lerp8by8.
+#ifndef FLICKER_MS
+#define FLICKER_MS 256
+#endif
+
+// noise8() steps per frame, 256 is one new random value a frame
+#ifndef FLICKER_STEP
+#define FLICKER_STEP 64
+#endif
+
+void effect(pt_t *pt)
 {
-    led_color[1] = 0xff;
+    static uint16_t t;
+
+    PT_BEGIN(pt);
 
+    // each throwie its own stretch of the flame
+    t = (uint16_t)tiny_rand() << 8;
     while (1)
     {
-        while (adc_sample() < 100)
-        {
-            if (led_color[1])
-            {
-                led_color[1] = 0;
-                update_led();
-            }
-            // nap(0xf000); // 60 seconds
-            nap(10240);
-        }
+        uint8_t level = 0x60 + (noise8(t) >> 3) + (noise8(t << 1) >> 3);
 
-        // Don't want to hit the ADC every loop
-        uint8_t counter = 0xff;
-        while (counter--)
-        {
-            uint8_t rand_byte = tiny_rand();
-            if ((rand_byte % 8) == 0)
-            {
-                led_color[1] = 0x60;
-            }
-            else
-            {
-                led_color[1] = 0x7f;
-            }
-            update_led();
-            if ((rand_byte % 5) == 0)
-            {
-                nap(64);
-            }
-            nap(64);
-        }
+        led_set(1, level);      // red
+        led_set(0, level >> 3); // a little green for the yellow in it
+        t += FLICKER_STEP;
+        PT_SHOW(pt, FLICKER_MS);
     }
+
+    PT_END(pt);
 }
 
 #elif SIREN
 
-void effect()
+void effect(pt_t *pt)
 {
+    PT_BEGIN(pt);
+
     while (1)
     {
+        led_set(2, 0x00);
+        led_set(1, 0xff);
+        PT_SHOW(pt, 128);
+        led_set(1, 0x00);
+        led_set(2, 0xff);
+        PT_SHOW(pt, 128);
+    }
 
-        while (adc_sample() < 100)
+    PT_END(pt);
+}
+
+#elif MORSE
+
+// The message, packed at build time by tools/morse (see build.sh) into
+// one bit per unit, MSB first, 1 lit and 0 dark, with the gaps between
+// elements, characters and words already in it. Playing it is shift,
+// show, nap, and PT_SHOW() merges the runs of equal bits into one nap.
+#include "morse.h"
+
+#ifndef MORSE_UNIT
+#define MORSE_UNIT 128 // ms
+#endif
+
+void effect(pt_t *pt)
+{
+    static uint16_t i;
+    static uint8_t bits;
+
+    PT_BEGIN(pt);
+
+    while (1)
+    {
+        for (i = 0; i < MORSE_BITS; i++)
         {
-            if (led_color[2])
+            if (!(i & 7))
             {
-                led_color[2] = 0x00;
-                update_led();
+                bits = morse[i >> 3];
             }
-            // nap(0xf000); // 60 seconds
-            nap(10240);
+            led_set(0, bits & 0x80 ? 0xff : 0x00);
+            bits <<= 1;
+            PT_SHOW(pt, MORSE_UNIT);
         }
+        led_set(0, 0x00);
+        PT_SHOW(pt, 0xf000);
+    }
 
-        // Don't want to hit the ADC every loop
-        uint8_t counter = 0xff;
-        while (counter--)
-        {
-            led_color[2] = 0x00;
-            led_color[1] = 0xff;
-            update_led();
-            nap(128);
-            led_color[1] = 0x00;
-            led_color[2] = 0xff;
-            update_led();
-            nap(128);
-        }
+    PT_END(pt);
+}
+
+#elif PATTERN
+
+// The effect as bytecode in flash, see pattern.h for the ops. build.sh
+// assembles PATTERN_FILE (tools/patterns/breathe.pat by default) into
+// avrgcc/bytecode.h with tools/pattern, so the interpreter's flash is
+// paid once and each effect only costs its bytes. SRAM: the colour,
+// the level, the pc and k, 6 bytes, loops are unrolled at assembly so
+// there's no loop count.
+//
+// PATTERN_FILE can list several patterns, which makes an image that
+// switches between them, see light_task(). Which one plays is the one
+// pattern_pc is in, so that costs no SRAM.
+#include "pattern.h"
+#include "bytecode.h"
+
+#define EFFECT_COUNT PATTERN_COUNT
+
+uint8_t pattern_pc;
+uint8_t pattern_color[3];
+uint8_t pattern_level;
+const uint8_t pattern_random[4] = {0x00, 0x55, 0xaa, 0xff};
+
+// Every pixel shows color at brightness in 8.8 fixed point. Phase 0
+// takes the top 8 bits as they are, so a held frame is exact, anything
+// else dithers them like BREATHE's dim(). Brightness goes through
+// led_gamma() first.
+void pattern_dim(const uint8_t *color, uint16_t brightness, uint8_t phase)
+{
+    brightness = led_gamma(brightness);
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        uint16_t value = scale16by8(brightness, color[i]);
+        led_set(i, !color[i] ? 0 : phase ? dither8(value, phase) : value >> 8);
     }
 }
 
-#elif MORSE
+// Start of the pattern pc is in
+uint8_t pattern_first(uint8_t pc)
+{
+    uint8_t first = 0;
 
-const uint8_t str[] PROGMEM = "TESTING";
-const uint8_t str_len = sizeof(str) - 1;
-const uint8_t unit_len = 128;
-
-// Morse code mapping
-// highest 3 bits are the length of the sequence
-// lower bits are the sequence from low to high
-// eg: A = 0b00100010, 010 = 2, 00010, from right to left: 0 = dot, 1 = dash
-const uint8_t codes[43] PROGMEM = {
-    // 0-9
-    0b10111111,
-    0b10111110,
-    0b10111100,
-    0b10111000,
-    0b10110000,
-    0b10100000,
-    0b10100001,
-    0b10100011,
-    0b10100111,
-    0b10101111,
-    // :-@
-    0b00000000,
-    0b00000000,
-    0b00000000,
-    0b00000000,
-    0b00000000,
-    0b00000000,
-    0b00000000,
-    // A-Z
-    0b01000010,
-    0b10000001,
-    0b10000101,
-    0b01100001,
-    0b00100000,
-    0b10000100,
-    0b01100011,
-    0b10000000,
-    0b01000000,
-    0b10001110,
-    0b01100101,
-    0b10000010,
-    0b01000011,
-    0b01000001,
-    0b01100111,
-    0b10000110,
-    0b10001011,
-    0b01100010,
-    0b01100000,
-    0b00100001,
-    0b01100100,
-    0b10001000,
-    0b01100110,
-    0b10001001,
-    0b10001101,
-    0b10000011,
-};
-
-void blink(uint8_t code)
-{
-    uint8_t code_len = code >> 5;
-
-    while (code_len--)
+    for (uint8_t i = 1; i < PATTERN_COUNT; i++)
     {
-        led_color[0] = 0xff;
-        update_led();
-
-        if (code & 1)
-        {
-            nap(unit_len * 3); // send dash
-        }
-        else
+        if (pc >= pattern_start[i])
         {
-            nap(unit_len); // send dit
+            first = pattern_start[i];
         }
+    }
+    return first;
+}
 
-        led_color[0] = 0x00;
-        update_led();
-
-        nap(unit_len); // 1 unit between parts
+// Start the next pattern, after the last the first, on the next dusk
+void effect_next()
+{
+    uint8_t next = 0;
 
-        code >>= 1;
+    for (uint8_t i = PATTERN_COUNT - 1; i && pattern_start[i] > pattern_pc; i--)
+    {
+        next = pattern_start[i];
     }
-    nap(unit_len * 3); // 3 units between letters
+    pattern_pc = next;
 }
 
-void effect()
+// The colour at the level, exactly
+void pattern_hold()
 {
-    uint8_t code;
+    pattern_dim(pattern_color, (uint16_t)pattern_level << 8 | pattern_level, 0);
+}
+
+void effect(pt_t *pt)
+{
+    static uint8_t k; // frame of a ramp, unit of MORSE
+
+    PT_BEGIN(pt);
 
+    // every run starts from dark, whatever the last one ended on
+    pattern_pc = pattern_first(pattern_pc);
+    pattern_level = 0;
+    memset(pattern_color, 0, sizeof(pattern_color));
     while (1)
     {
-        if (adc_sample() > 100)
+        // Locals don't survive PT_SHOW(), the ops that show read their
+        // operands from pattern[pattern_pc] again every frame
+        uint8_t op = pattern[pattern_pc] & 0xf0;
+        uint8_t n = pattern[pattern_pc] & 0x0f;
+
+        if (op == PAT_COLOR)
+        {
+            memcpy(pattern_color, &pattern[pattern_pc + 1], 3);
+            pattern_pc += 4;
+        }
+        else if (op == PAT_RANDOM)
+        {
+            uint8_t color = tiny_rand();
+            for (uint8_t i = 0; i < 3; i++)
+            {
+                pattern_color[i] = pattern_random[color & 0b11];
+                color >>= 2;
+            }
+            pattern_pc += 1;
+        }
+        else if (op == PAT_LEVEL)
+        {
+            pattern_level = pattern[pattern_pc + 1];
+            pattern_pc += 2;
+        }
+        else if (op == PAT_FADE || op == PAT_RAMP)
         {
-            for (uint8_t i = 0; i < str_len; i++)
+            k = 0;
+            do
             {
-                code = str[i];
-                // 7 units for space
-                if (code == 0x20)
+                uint8_t shift = pattern[pattern_pc] & 0x0f;
+                uint16_t level = (uint16_t)pattern_level << 8 | pattern_level;
+
+                if ((pattern[pattern_pc] & 0xf0) == PAT_FADE)
                 {
-                    nap(unit_len * 7);
+                    uint8_t mix[3];
+                    for (uint8_t i = 0; i < 3; i++)
+                    {
+                        mix[i] = blend8(pattern_color[i], pattern[pattern_pc + 2 + i], k << (8 - shift));
+                    }
+                    pattern_dim(mix, level, 0);
                 }
-                // number or letter
                 else
                 {
-                    blink(codes[code - 0x30]);
+                    uint16_t eased = ease_curve((uint16_t)k << (16 - shift));
+                    uint8_t to = pattern[pattern_pc + 2];
+
+                    // scale16by8() scales by (x + 1) / 256, so x is the
+                    // distance - 1 and the ramp can't overshoot
+                    if (to > pattern_level)
+                    {
+                        level += scale16by8(eased, to - pattern_level - 1);
+                    }
+                    else if (to < pattern_level)
+                    {
+                        level -= scale16by8(eased, pattern_level - to - 1);
+                    }
+                    pattern_dim(pattern_color, level, k | 4);
                 }
+                PT_SHOW_TICKS(pt, pattern[pattern_pc + 1]);
+            } while (++k != (uint8_t)(1 << (pattern[pattern_pc] & 0x0f)));
+
+            if ((pattern[pattern_pc] & 0xf0) == PAT_FADE)
+            {
+                memcpy(pattern_color, &pattern[pattern_pc + 2], 3);
+                pattern_pc += 5;
+            }
+            else
+            {
+                pattern_level = pattern[pattern_pc + 2];
+                pattern_pc += 3;
+            }
+        }
+        else if (op == PAT_WAIT)
+        {
+            pattern_hold();
+            PT_SHOW_TICKS(pt, pattern[pattern_pc + 1] | (uint16_t)pattern[pattern_pc + 2] << 8);
+            pattern_pc += 3;
+        }
+        else if (op == PAT_CHANCE)
+        {
+            pattern_pc += 2;
+            if (tiny_rand() > pattern[pattern_pc - 1])
+            {
+                pattern_pc += n;
+            }
+        }
+        else if (op == PAT_MORSE)
+        {
+            for (k = 0; k < pattern[pattern_pc + 1]; k++)
+            {
+                pattern_level = pattern[pattern_pc + 3 + (k >> 3)] << (k & 7) & 0x80 ? 0xff : 0x00;
+                pattern_hold();
+                PT_SHOW_TICKS(pt, pattern[pattern_pc + 2]);
+            }
+            pattern_level = 0x00;
+            pattern_pc += 3 + ((pattern[pattern_pc + 1] + 7) >> 3);
+        }
+        else // PAT_DARK
+        {
+            // Off until the light task starts the pattern over at dusk
+            pattern_level = 0x00;
+            pattern_hold();
+            PT_SHOW_TICKS(pt, 0);
+            while (1)
+            {
+                PT_SLEEP_TICKS(pt, 0xffff);
+            }
+        }
+
+        // Off the end, back to the start of the same pattern
+        for (uint8_t i = 1; i <= PATTERN_COUNT; i++)
+        {
+            if (pattern_pc == pattern_start[i])
+            {
+                pattern_pc = pattern_start[i - 1];
             }
         }
-        nap(0xf000);
     }
+
+    PT_END(pt);
 }
 
 #endif
 
+#ifndef EFFECT_COUNT
+#define EFFECT_COUNT 1
+#endif
+
+// Two tasks share the core: the effect, a protothread that yields how
+// long to sleep between its steps, and the light check, which runs every
+// LIGHT_TASK_MS while it's dark. Once it gets light that parks the
+// effect, clears the LEDs and waits in nap_dark() until it's dark again,
+// then the effect starts over. SRAM: 4 bytes for the effect task plus
+// its statics, 1 for the light task.
+#define LIGHT_TASK_MS 2048
+
+pt_t effect_pt;
+uint8_t light_sleep; // PT_TICK_MS periods until the next light check
+
+// Switching effects, in an image with more than one. Cover the
+// photoresistor until the LEDs light up, which can take up to
+// AMBIENT_POLL_MAX while it's light, and uncover it again within
+// GESTURE_CHECKS light checks: the LEDs go off and the next effect plays
+// from the next dark on, so covering it again shows which one that is.
+//
+// The tracker's average takes several checks to follow the uncovered
+// sensor, so the light checks right after dusk also take a raw
+// adc_sample() and a single light reading counts. A real dusk reads
+// darker than AMBIENT_DARK by then, and later in the night only the
+// average decides, so shadows and headlights can't switch effects.
+// The checks left are counted in 2 spare bits of ambient_state.
+#define GESTURE_CHECKS 2 // 4 s
+
+#if GESTURE_CHECKS < 1 || GESTURE_CHECKS > 3
+#error "GESTURE_CHECKS must be between 1 and 3"
+#endif
+
+#if EFFECT_COUNT > 1
+
+uint8_t gesture_seen()
+{
+    if (!(ambient_state & 0x30))
+    {
+        return 0;
+    }
+    ambient_state -= 0x10;
+
+    uint16_t reading = adc_sample();
+    if (reading >> 2 > AMBIENT_LIGHT)
+    {
+        return 0;
+    }
+
+    // Light from here, the tracker starts over from this reading and
+    // the checks left with it
+    ambient = reading << 6;
+    ambient_state = AMBIENT_POLL_MIN;
+    effect_next();
+    return 1;
+}
+
+#else
+#define gesture_seen() 0
+#endif
+
+void light_task()
+{
+    if (!gesture_seen() && ambient_dark())
+    {
+        return;
+    }
+
+    memset(led_color, 0, sizeof(led_color));
+    led_show();
+    PT_INIT(&effect_pt);
+    effect_pt.sleep = 0;
+
+    do
+    {
+        nap_dark();
+    } while (!ambient_dark());
+
+#if EFFECT_COUNT > 1
+    ambient_state = (ambient_state & ~0x30) | GESTURE_CHECKS << 4;
+#endif
+}
+
 int main(void)
 {
     // disable protection
@@ -392,15 +1124,37 @@ int main(void)
     // disable clock divider
     CLKPSR = 0;
 
-    // PB0 used for photoresistor input
-    DDRB = 0b1110;
-    PORTB = 0b0000;
-
-    // Digital input disable on ADC pins
-    DIDR0 = (1 << ADC0D) | (1 << ADC1D);
+    power_init();
 
     // Clear LED
     update_led();
 
-    effect();
-}
\ No newline at end of file
+#if CLK_SLOW
+    clock_set(CLK_SLOW);
+#endif
+
+    // Seed tiny_rand() from the LSB noise of a few readings, about 3 ms.
+    // After clock_set(), ADC_PRESCALE assumes CLK_SLOW.
+    for (uint8_t i = 0; i < RAND_SEED_READINGS; i++)
+    {
+        adc_sample();
+    }
+
+    while (1)
+    {
+        if (!light_sleep)
+        {
+            light_task();
+            light_sleep = LIGHT_TASK_MS / PT_TICK_MS;
+        }
+        if (!effect_pt.sleep)
+        {
+            effect(&effect_pt);
+        }
+
+        uint16_t ticks = effect_pt.sleep < light_sleep ? effect_pt.sleep : light_sleep;
+        nap_plan(ticks * PT_TICK_MS);
+        effect_pt.sleep -= ticks;
+        light_sleep -= ticks;
+    }
+}
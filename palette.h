@@ -0,0 +1,21 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+/*
+FastLED's PartyColors_p as 16 entries of r, g, b for lib8tion's
+color_from_palette16(), 48 bytes. BREATHE_COLOR 2 picks its colours
+from it and tools/lib8bench times and checks the lookup on it, so they
+all use this one copy. PROGMEM has to be defined first, the host
+defines it empty.
+*/
+
+#include <stdint.h>
+
+const uint8_t party_palette[48] PROGMEM = {
+    0x55, 0x00, 0xab, 0x84, 0x00, 0x7c, 0xb5, 0x00, 0x4b, 0xe5, 0x00, 0x1b,
+    0xe8, 0x17, 0x00, 0xb8, 0x47, 0x00, 0xab, 0x77, 0x00, 0xab, 0xab, 0x00,
+    0xab, 0x55, 0x00, 0xdd, 0x22, 0x00, 0xf2, 0x00, 0x0e, 0xc2, 0x00, 0x3e,
+    0x8f, 0x00, 0x71, 0x5f, 0x00, 0xa1, 0x2f, 0x00, 0xd0, 0x00, 0x07, 0xf9,
+};
+
+#endif
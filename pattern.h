@@ -0,0 +1,56 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+/*
+Bytecode for the PATTERN effect, which plays an effect from flash instead
+of running one written in C. tools/pattern assembles it from a text file
+(see tools/patterns/ for BREATHE, FLICKER, SIREN and MORSE written that
+way), and main.c's interpreter runs it.
+
+The high nibble of an op's first byte is the op, the low nibble n an
+argument, and the operand bytes follow. Times are in PT_TICK_MS periods.
+The interpreter works on a colour, which all pixels show, and a level it
+is shown at (255 is the colour as it is). Ops that show something hold
+the frame for their time, the others take none. Running off the end
+starts the pattern over, as does the effect being parked at dawn.
+
+    op      operands           what it does
+    COLOR   g r b              set the colour
+    RANDOM                     pick a colour, 0/0x55/0xaa/0xff per channel
+    LEVEL   v                  set the level
+    FADE    t g r b            blend to g r b in 2^n frames of t each
+    RAMP    t v                ease the level to v in 2^n frames of t each,
+                               dithered like BREATHE
+    WAIT    t_lo t_hi          show colour and level, hold for t
+    CHANCE  p                  go on with probability (p + 1) / 256, else
+                               skip the next n bytes
+    MORSE   count t bits...    count units of t, lit for each 1 bit (MSB
+                               first), level 0 after
+    DARK                       switch off and wait for the next night
+
+The ramps show their start value first and stop a frame short of the end
+value, which the next op that shows something picks up, so a ramp
+followed by another doesn't show the turning point twice. There are no
+loops, tools/pattern unrolls them.
+*/
+
+#define PAT_COLOR 0x00
+#define PAT_RANDOM 0x10
+#define PAT_LEVEL 0x20
+#define PAT_FADE 0x30
+#define PAT_RAMP 0x40
+#define PAT_WAIT 0x50
+#define PAT_CHANCE 0x60
+#define PAT_MORSE 0x70
+#define PAT_DARK 0x80
+
+// Most bytes of all patterns in an image together, the interpreter's
+// program counter is a byte and the end is in pattern_start[]
+#define PAT_MAX 255
+// Most frames in a ramp, n is at most PAT_RAMP_MAX
+#define PAT_RAMP_MAX 8
+// Longest WAIT, a little under 0xffff periods since the frames merged
+// into it add to the same 16-bit sleep, see PT_SHOW_TICKS()
+#define PAT_WAIT_MAX 0xff00
+
+#endif
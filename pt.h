@@ -0,0 +1,69 @@
+#ifndef PT_H
+#define PT_H
+
+/*
+Protothreads, cut down for throwie2: a task is a function that gets
+called again whenever its sleep runs out, and picks up after the last
+PT_SLEEP() it returned from. The continuation is a GCC label address,
+so a task costs 4 bytes of SRAM: where to resume and how long to sleep.
+
+Locals don't survive a PT_SLEEP(), anything that has to is static. A
+task must not use switch around a PT_SLEEP() either, nor PT_SLEEP() in
+a function it calls.
+
+    void blink(pt_t *pt)
+    {
+        PT_BEGIN(pt);
+        while (1)
+        {
+            led_color[0] ^= 0xff;
+            update_led();
+            PT_SLEEP(pt, 512);
+        }
+        PT_END(pt);
+    }
+*/
+
+#include <stdint.h>
+
+// Sleep is counted in watchdog periods, so 16 bits cover the 60 s naps
+#define PT_TICK_MS 16
+
+typedef struct
+{
+    void *lc;       // label to resume at, NULL to start over
+    uint16_t sleep; // PT_TICK_MS periods until the next call
+} pt_t;
+
+#define PT_CAT_(a, b) a##b
+#define PT_CAT(a, b) PT_CAT_(a, b)
+
+// Start the task from the top on its next call
+#define PT_INIT(pt) ((pt)->lc = 0)
+
+#define PT_BEGIN(pt)        \
+    do                      \
+    {                       \
+        if ((pt)->lc)       \
+        {                   \
+            goto *(pt)->lc; \
+        }                   \
+    } while (0)
+
+// Return to the scheduler and resume here after ticks PT_TICK_MS periods
+#define PT_SLEEP_TICKS(pt, ticks)                  \
+    do                                             \
+    {                                              \
+        (pt)->lc = &&PT_CAT(pt_resume_, __LINE__); \
+        (pt)->sleep = (ticks);                     \
+        return;                                    \
+        PT_CAT(pt_resume_, __LINE__):;             \
+    } while (0)
+
+// Same in ms, rounded down to whole watchdog periods
+#define PT_SLEEP(pt, ms) PT_SLEEP_TICKS(pt, (ms) / PT_TICK_MS)
+
+// A task that runs off its end starts over on the next call
+#define PT_END(pt) PT_INIT(pt)
+
+#endif
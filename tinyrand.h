@@ -0,0 +1,45 @@
+#ifndef TINYRAND_H
+#define TINYRAND_H
+
+/*
+Random numbers for the effects: a 16-bit xorshift (Marsaglia's 7, 9, 8
+triple), which steps through every non-zero state once, a period of
+65535, with only shifts and xors, so the reduced core without MUL runs
+it in a few dozen cycles. 2 bytes of SRAM.
+
+The state starts at 1 out of reset, so every throwie would play the
+same sequence. rand_stir() folds a reading's noise into it, adc_sample()
+stirs every reading in, and main() takes a few at power on so throwies
+switched on together part ways before their first effect frame. Each
+stir jumps to another point of the same cycle, so the period holds.
+
+tools/randtest compares it with the 8-bit LFSR it replaced and with
+lib8tion's random8(), and times all three on the AVRrc model.
+*/
+
+#include <stdint.h>
+
+static uint16_t rand_state = 1;
+
+static inline uint8_t tiny_rand(void)
+{
+    uint16_t x = rand_state;
+
+    x ^= x << 7;
+    x ^= x >> 9;
+    x ^= x << 8;
+    rand_state = x;
+    return x;
+}
+
+static inline void rand_stir(uint8_t noise)
+{
+    rand_state ^= noise;
+    if (!rand_state)
+    {
+        rand_state = 1; // the one state xorshift never leaves
+    }
+    tiny_rand(); // spread the noise over both bytes
+}
+
+#endif
@@ -0,0 +1,1110 @@
+#include "avrrc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char *const avr_state_names[AVR_STATES] = {
+    "active", "idle", "adc noise reduction", "power-down", "standby"};
+
+// SREG bits
+#define SREG_C 0
+#define SREG_Z 1
+#define SREG_N 2
+#define SREG_V 3
+#define SREG_S 4
+#define SREG_H 5
+#define SREG_T 6
+#define SREG_I 7
+
+// Peripheral bits used by the model
+#define WDIF 7
+#define WDIE 6
+#define WDP3 5
+#define WDE 3
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define PRADC 1
+#define SE 0
+
+#define CCP_SIGNATURE 0xD8
+#define CCP_WINDOW 4 // cycles the protected registers stay unlocked
+
+#define WAKE_HALT_CYCLES 4   // core halted after waking up
+#define STARTUP_CYCLES 6     // oscillator start-up from power-down/standby
+#define IRQ_CYCLES 4         // interrupt response
+
+#define WDT_TICKS_16MS 128000 // 2048 cycles of the 128 kHz oscillator
+
+// PB0 input thresholds on the 0..255 light scale, the datasheet only
+// promises below 0.3 VCC reads low and above 0.6 VCC high
+#define PB0_LOW 115
+#define PB0_HIGH 140
+// how often the light level is looked at while a pin change can wake
+#define PIN_POLL_TICKS 16000 // 2 ms
+
+// ATtiny5 signature, read through the data space at 0x3FC0
+static const uint8_t signature[3] = {0x1E, 0x8F, 0x0A};
+
+void avr_init(avr_t *avr)
+{
+    memset(avr, 0, sizeof(*avr));
+    memset(avr->flash, 0xFF, sizeof(avr->flash));
+    avr_reset(avr);
+    avr->sp_min = avr->io[AVR_SPL];
+}
+
+void avr_reset(avr_t *avr)
+{
+    memset(avr->r, 0, sizeof(avr->r));
+    memset(avr->io, 0, sizeof(avr->io));
+    avr->io[AVR_CLKPSR] = 0x03; // 8 MHz / 8 out of reset
+    avr->io[AVR_SPL] = AVR_SRAM_START + AVR_SRAM_SIZE - 1;
+    avr->pc = 0;
+    avr->state = AVR_ACTIVE;
+    avr->ccp_until = 0;
+    avr->irq_inhibit = 0;
+    avr->wdt_start = avr->ticks;
+    avr->adc_running = 0;
+    avr->adc_first = 1;
+    avr->pb0_in = 0;
+}
+
+/*
+Loading
+*/
+
+static int load_hex(avr_t *avr, FILE *f, const char *path)
+{
+    char line[600];
+    uint32_t base = 0;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        unsigned len, addr, type;
+        if (line[0] != ':' || sscanf(line + 1, "%2x%4x%2x", &len, &addr, &type) != 3)
+            continue;
+        if (type == 1)
+            break;
+        if (type == 2 || type == 4)
+        {
+            unsigned hi;
+            sscanf(line + 9, "%4x", &hi);
+            base = type == 2 ? hi << 4 : hi << 16;
+            continue;
+        }
+        if (type != 0)
+            continue;
+        for (unsigned i = 0; i < len; i++)
+        {
+            unsigned byte;
+            uint32_t a = base + addr + i;
+            if (sscanf(line + 9 + i * 2, "%2x", &byte) != 1)
+                break;
+            if (a >= AVR_FLASH_SIZE)
+            {
+                fprintf(stderr, "%s: data at 0x%x is outside flash\n", path, a);
+                return -1;
+            }
+            ((uint8_t *)avr->flash)[a] = byte;
+            if (a + 1 > avr->flash_size)
+                avr->flash_size = a + 1;
+        }
+    }
+    return 0;
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t rd16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static int load_elf(avr_t *avr, const uint8_t *elf, long size, const char *path, avr_syms_t *syms)
+{
+    if (size < 52 || elf[4] != 1 || elf[5] != 1)
+    {
+        fprintf(stderr, "%s: not a 32-bit little endian ELF\n", path);
+        return -1;
+    }
+    if (rd16(elf + 18) != 83)
+    {
+        fprintf(stderr, "%s: not an AVR ELF\n", path);
+        return -1;
+    }
+
+    uint32_t phoff = rd32(elf + 28), shoff = rd32(elf + 32);
+    uint16_t phentsize = rd16(elf + 42), phnum = rd16(elf + 44);
+    uint16_t shentsize = rd16(elf + 46), shnum = rd16(elf + 48);
+
+    // PT_LOAD segments by load address: .text and the .data/.rodata
+    // images live in flash, anything from 0x800000 up is RAM or fuses
+    for (int i = 0; i < phnum; i++)
+    {
+        const uint8_t *ph = elf + phoff + i * phentsize;
+        uint32_t offset = rd32(ph + 4), paddr = rd32(ph + 12), filesz = rd32(ph + 16);
+        if (rd32(ph) != 1 || filesz == 0 || paddr >= 0x800000)
+            continue;
+        if (paddr + filesz > AVR_FLASH_SIZE || offset + filesz > (uint32_t)size)
+        {
+            fprintf(stderr, "%s: segment at 0x%x does not fit in flash\n", path, paddr);
+            return -1;
+        }
+        memcpy((uint8_t *)avr->flash + paddr, elf + offset, filesz);
+        if (paddr + filesz > avr->flash_size)
+            avr->flash_size = paddr + filesz;
+    }
+
+    // Allocated sections in SRAM, .data and .bss, which the stack must
+    // stay clear of
+    avr->sram_static = 0;
+    for (int i = 0; i < shnum; i++)
+    {
+        const uint8_t *sh = elf + shoff + i * shentsize;
+        uint32_t addr = rd32(sh + 12), end = addr + rd32(sh + 20);
+        if (!(rd32(sh + 8) & 2) || addr < 0x800000 + AVR_SRAM_START || addr >= 0x800000 + 0x10000) // SHF_ALLOC
+            continue;
+        if (end - 0x800000 - AVR_SRAM_START > avr->sram_static)
+            avr->sram_static = end - 0x800000 - AVR_SRAM_START;
+    }
+
+    if (!syms)
+        return 0;
+    syms->sym = NULL;
+    syms->count = 0;
+
+    for (int i = 0; i < shnum; i++)
+    {
+        const uint8_t *sh = elf + shoff + i * shentsize;
+        if (rd32(sh + 4) != 2) // SHT_SYMTAB
+            continue;
+        const uint8_t *strsh = elf + shoff + rd32(sh + 24) * shentsize;
+        const char *strtab = (const char *)elf + rd32(strsh + 16);
+        uint32_t off = rd32(sh + 16), len = rd32(sh + 20), entsize = rd32(sh + 36);
+
+        syms->sym = calloc(len / entsize, sizeof(avr_sym_t));
+        for (uint32_t e = 0; e < len / entsize; e++)
+        {
+            const uint8_t *st = elf + off + e * entsize;
+            uint8_t type = st[12] & 0x0F;
+            if (rd32(st) == 0 || (type != 1 && type != 2)) // STT_OBJECT, STT_FUNC
+                continue;
+            avr_sym_t *s = &syms->sym[syms->count++];
+            snprintf(s->name, sizeof(s->name), "%s", strtab + rd32(st));
+            s->addr = rd32(st + 4);
+            s->size = rd32(st + 8);
+            s->func = type == 2;
+        }
+    }
+    return 0;
+}
+
+int avr_load(avr_t *avr, const char *path, avr_syms_t *syms)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+
+    uint8_t magic[4] = {0};
+    int ret;
+    if (fread(magic, 1, 4, f) == 4 && memcmp(magic, "\177ELF", 4) == 0)
+    {
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        uint8_t *elf = malloc(size);
+        rewind(f);
+        ret = fread(elf, 1, size, f) == (size_t)size ? load_elf(avr, elf, size, path, syms) : -1;
+        free(elf);
+    }
+    else
+    {
+        rewind(f);
+        if (syms)
+            syms->count = 0, syms->sym = NULL;
+        ret = load_hex(avr, f, path);
+    }
+    fclose(f);
+    return ret;
+}
+
+const avr_sym_t *avr_sym_find(const avr_syms_t *syms, const char *name)
+{
+    for (int i = 0; syms && i < syms->count; i++)
+    {
+        if (strcmp(syms->sym[i].name, name) == 0)
+            return &syms->sym[i];
+    }
+    return NULL;
+}
+
+void avr_syms_free(avr_syms_t *syms)
+{
+    free(syms->sym);
+    syms->sym = NULL;
+    syms->count = 0;
+}
+
+/*
+Peripherals
+*/
+
+static uint64_t cycle_ticks(const avr_t *avr)
+{
+    return 1ull << avr_clkps(avr);
+}
+
+static uint64_t wdt_period(const avr_t *avr)
+{
+    uint8_t w = avr->io[AVR_WDTCSR];
+    unsigned wdp = (w & 0x07) | ((w >> WDP3) & 1) << 3;
+    if (wdp > 9)
+        wdp = 9;
+    return (uint64_t)WDT_TICKS_16MS << wdp;
+}
+
+static int wdt_running(const avr_t *avr)
+{
+    return avr->io[AVR_WDTCSR] & (1 << WDIE | 1 << WDE);
+}
+
+static uint8_t light_level(const avr_t *avr)
+{
+    return avr->light ? avr->light(avr->light_ctx, avr->ticks) : 0;
+}
+
+// PB0 sits between the photoresistor and a resistor powered from PB1,
+// it only reads the light level while PB1 drives the divider high
+static uint8_t pb0_level(const avr_t *avr)
+{
+    return (avr->io[AVR_DDRB] & avr->io[AVR_PORTB] & 0x02) ? light_level(avr) : 0;
+}
+
+// PB0's digital input, a Schmitt trigger, when DIDR0 leaves it enabled
+static int pb0_digital(const avr_t *avr)
+{
+    if (avr->io[AVR_DIDR0] & 1)
+        return 0;
+    uint8_t level = pb0_level(avr);
+    if (level >= PB0_HIGH)
+        return 1;
+    if (level <= PB0_LOW)
+        return 0;
+    return avr->pb0_in;
+}
+
+static int pin_watched(const avr_t *avr)
+{
+    return (avr->io[AVR_PCMSK] & 1) && !(avr->io[AVR_DIDR0] & 1);
+}
+
+// Latch PB0's input and raise the pin change flag when it toggled
+static void update_pins(avr_t *avr)
+{
+    int in = pb0_digital(avr);
+
+    if (in == avr->pb0_in)
+        return;
+    avr->pb0_in = in;
+    if (avr->io[AVR_PCMSK] & 1)
+        avr->io[AVR_PCIFR] |= 1;
+}
+
+static uint8_t adc_input(const avr_t *avr)
+{
+    uint8_t mux = avr->io[AVR_ADMUX] & 0x03;
+
+    if (mux == 0)
+        return pb0_level(avr);
+    return (avr->io[AVR_PORTB] & avr->io[AVR_DDRB] & (1 << mux)) ? 0xFF : 0;
+}
+
+static void adc_start(avr_t *avr)
+{
+    static const uint8_t prescale[8] = {2, 2, 4, 8, 16, 32, 64, 128};
+
+    if (!(avr->io[AVR_ADCSRA] & (1 << ADEN)) || (avr->io[AVR_PRR] & (1 << PRADC)))
+        return;
+
+    uint64_t clocks = avr->adc_first ? 25 : 13;
+    avr->adc_first = 0;
+    avr->adc_running = 1;
+    avr->adc_value = adc_input(avr);
+    avr->adc_done = avr->ticks + clocks * prescale[avr->io[AVR_ADCSRA] & 0x07] * cycle_ticks(avr);
+    avr->io[AVR_ADCSRA] |= 1 << ADSC;
+}
+
+static void adc_complete(avr_t *avr)
+{
+    avr->adc_running = 0;
+    avr->io[AVR_ADCL] = avr->adc_value;
+    avr->io[AVR_ADCSRA] &= ~(1 << ADSC);
+    avr->io[AVR_ADCSRA] |= 1 << ADIF;
+
+    // free running auto trigger source starts the next one right away
+    if ((avr->io[AVR_ADCSRA] & (1 << ADATE)) && (avr->io[AVR_ADCSRB] & 0x07) == 0)
+        adc_start(avr);
+}
+
+// Move time forward, firing peripheral events that fall inside it
+static void advance(avr_t *avr, uint64_t ticks)
+{
+    uint64_t end = avr->ticks + ticks;
+
+    while (avr->ticks < end)
+    {
+        uint64_t next = end;
+        uint64_t wdt_at = avr->wdt_start + wdt_period(avr);
+        int adc_live = avr->adc_running && avr->state != AVR_POWER_DOWN && avr->state != AVR_STANDBY;
+
+        if (wdt_running(avr) && wdt_at < next)
+            next = wdt_at;
+        if (adc_live && avr->adc_done < next)
+            next = avr->adc_done;
+        if (pin_watched(avr) && avr->ticks + PIN_POLL_TICKS < next)
+            next = avr->ticks + PIN_POLL_TICKS;
+        if (next < avr->ticks)
+            next = avr->ticks;
+
+        // the ADC clock is stopped in power-down, push its deadline along
+        if (avr->adc_running && !adc_live)
+            avr->adc_done += next - avr->ticks;
+
+        avr->state_ticks[avr->state] += next - avr->ticks;
+        avr->ticks = next;
+
+        if (wdt_running(avr) && avr->ticks >= wdt_at)
+        {
+            avr->wdt_start = wdt_at;
+            avr->io[AVR_WDTCSR] |= 1 << WDIF;
+        }
+        if (adc_live && avr->ticks >= avr->adc_done)
+            adc_complete(avr);
+        if (pin_watched(avr))
+            update_pins(avr);
+    }
+}
+
+static void spend(avr_t *avr, unsigned cycles)
+{
+    avr->cycles += cycles;
+    advance(avr, cycles * cycle_ticks(avr));
+}
+
+static int pending_vector(const avr_t *avr)
+{
+    const uint8_t *io = avr->io;
+
+    if ((io[AVR_PCIFR] & 1) && (io[AVR_PCICR] & 1))
+        return AVR_VECT_PCINT0;
+    if ((io[AVR_WDTCSR] & (1 << WDIF)) && (io[AVR_WDTCSR] & (1 << WDIE)))
+        return AVR_VECT_WDT;
+    if ((io[AVR_ADCSRA] & (1 << ADIF)) && (io[AVR_ADCSRA] & (1 << ADIE)))
+        return AVR_VECT_ADC;
+    return 0;
+}
+
+static int can_wake(const avr_t *avr, int vect)
+{
+    switch (avr->state)
+    {
+    case AVR_IDLE:
+        return vect != 0;
+    case AVR_ADC_NR:
+        return vect == AVR_VECT_ADC || vect == AVR_VECT_WDT || vect == AVR_VECT_PCINT0;
+    case AVR_POWER_DOWN:
+    case AVR_STANDBY:
+        return vect == AVR_VECT_WDT || vect == AVR_VECT_PCINT0;
+    default:
+        return 1;
+    }
+}
+
+/*
+Data space
+*/
+
+static uint8_t io_read(avr_t *avr, uint8_t a)
+{
+    uint8_t ddr = avr->io[AVR_DDRB], port = avr->io[AVR_PORTB];
+
+    switch (a)
+    {
+    case AVR_PINB:
+    {
+        // inputs: PB0 follows the light level unless its digital input
+        // is disabled, the rest float high through the pull-ups
+        uint8_t in = avr->io[AVR_PUEB] & ~ddr & 0x0E;
+        update_pins(avr);
+        in |= avr->pb0_in;
+        return ((port & ddr) | (in & ~ddr)) & 0x0F;
+    }
+    default:
+        return avr->io[a];
+    }
+}
+
+static void io_write(avr_t *avr, uint8_t a, uint8_t v)
+{
+    uint8_t *io = avr->io;
+
+    switch (a)
+    {
+    case AVR_PINB: // writing ones toggles PORTB
+        io_write(avr, AVR_PORTB, io[AVR_PORTB] ^ (v & 0x0F));
+        return;
+    case AVR_PORTB:
+    {
+        uint8_t old = io[AVR_PORTB];
+        io[AVR_PORTB] = v & 0x0F;
+        if (old != io[AVR_PORTB] && avr->on_portb)
+            avr->on_portb(avr->portb_ctx, avr, old, io[AVR_PORTB]);
+        update_pins(avr);
+        return;
+    }
+    case AVR_CCP:
+        if (v == CCP_SIGNATURE)
+            avr->ccp_until = avr->cycles + CCP_WINDOW;
+        return;
+    case AVR_CLKPSR:
+    case AVR_CLKMSR:
+        if (avr->cycles < avr->ccp_until)
+            io[a] = v;
+        return;
+    case AVR_WDTCSR:
+    {
+        // prescaler and WDE are protected, WDIE is not, and WDIF is
+        // cleared by writing a one to it. Changing the prescaler does not
+        // restart the counter, only enabling the watchdog does.
+        uint8_t old = io[a];
+        uint8_t protect = 1 << WDP3 | 1 << WDE | 0x07;
+        if (avr->cycles >= avr->ccp_until)
+            v = (v & ~protect) | (old & protect);
+
+        uint8_t wdif = (v & (1 << WDIF)) ? 0 : (old & (1 << WDIF));
+        int was_running = wdt_running(avr);
+        io[a] = (v & ~(1 << WDIF)) | wdif;
+        if (!was_running && wdt_running(avr))
+            avr->wdt_start = avr->ticks;
+        return;
+    }
+    case AVR_ADCSRA:
+    {
+        uint8_t flag = io[a] & (1 << ADIF);
+        if (v & (1 << ADIF))
+            flag = 0;
+        uint8_t running = io[a] & (1 << ADSC);
+        io[a] = (v & ~(1 << ADIF | 1 << ADSC)) | flag | running;
+
+        if (!(v & (1 << ADEN)))
+        {
+            avr->adc_running = 0;
+            avr->adc_first = 1;
+            io[a] &= ~(1 << ADSC);
+        }
+        else if ((v & (1 << ADSC)) && !avr->adc_running)
+            adc_start(avr);
+        return;
+    }
+    case AVR_PCIFR:
+        io[a] &= ~v;
+        return;
+    case AVR_ADCL:
+        return;
+    case AVR_PCMSK:
+        // only changes from here on count
+        avr->pb0_in = pb0_digital(avr);
+        io[a] = v;
+        return;
+    case AVR_DDRB:
+    case AVR_DIDR0:
+        io[a] = v;
+        update_pins(avr);
+        return;
+    case AVR_SPL: // a frame allocated with IN/SUBI/OUT instead of pushes
+    case AVR_SPH:
+        io[a] = v;
+        if ((io[AVR_SPL] | io[AVR_SPH] << 8) < avr->sp_min)
+            avr->sp_min = io[AVR_SPL] | io[AVR_SPH] << 8;
+        return;
+    default:
+        io[a] = v;
+    }
+}
+
+static uint8_t data_read(avr_t *avr, uint16_t a, unsigned *extra)
+{
+    if (a < 0x40)
+        return io_read(avr, a);
+    if (a < AVR_SRAM_START + AVR_SRAM_SIZE)
+        return avr->sram[a - AVR_SRAM_START];
+    if (a >= AVR_FLASH_MAP && a < AVR_FLASH_MAP + AVR_FLASH_SIZE)
+    {
+        if (extra)
+            *extra = 1;
+        return ((uint8_t *)avr->flash)[a - AVR_FLASH_MAP];
+    }
+    if (a >= 0x3FC0 && a < 0x3FC3)
+        return signature[a - 0x3FC0];
+    return 0xFF;
+}
+
+static void data_write(avr_t *avr, uint16_t a, uint8_t v)
+{
+    if (a < 0x40)
+        io_write(avr, a, v);
+    else if (a < AVR_SRAM_START + AVR_SRAM_SIZE)
+        avr->sram[a - AVR_SRAM_START] = v;
+}
+
+static uint16_t sp_get(const avr_t *avr)
+{
+    return avr->io[AVR_SPL] | avr->io[AVR_SPH] << 8;
+}
+
+static void sp_set(avr_t *avr, uint16_t sp)
+{
+    avr->io[AVR_SPL] = sp;
+    avr->io[AVR_SPH] = sp >> 8;
+    if (sp < avr->sp_min)
+        avr->sp_min = sp;
+}
+
+static void push(avr_t *avr, uint8_t v)
+{
+    uint16_t sp = sp_get(avr);
+    data_write(avr, sp, v);
+    sp_set(avr, sp - 1);
+}
+
+static uint8_t pop(avr_t *avr)
+{
+    uint16_t sp = sp_get(avr) + 1;
+    sp_set(avr, sp);
+    return data_read(avr, sp, NULL);
+}
+
+static void push_pc(avr_t *avr, uint16_t pc)
+{
+    push(avr, pc);
+    push(avr, pc >> 8);
+}
+
+static uint16_t pop_pc(avr_t *avr)
+{
+    uint16_t pc = pop(avr) << 8;
+    return pc | pop(avr);
+}
+
+/*
+CPU
+*/
+
+#define BIT(v, n) (((v) >> (n)) & 1)
+#define NBIT(v, n) (BIT(v, n) ^ 1)
+
+static void set_flag(avr_t *avr, int flag, int on)
+{
+    if (on)
+        avr->io[AVR_SREG] |= 1 << flag;
+    else
+        avr->io[AVR_SREG] &= ~(1 << flag);
+}
+
+static int flag(const avr_t *avr, int flag)
+{
+    return BIT(avr->io[AVR_SREG], flag);
+}
+
+static void flags_nzs(avr_t *avr, uint8_t r)
+{
+    set_flag(avr, SREG_N, BIT(r, 7));
+    set_flag(avr, SREG_Z, r == 0);
+    set_flag(avr, SREG_S, flag(avr, SREG_N) ^ flag(avr, SREG_V));
+}
+
+static uint8_t op_add(avr_t *avr, uint8_t d, uint8_t s, int carry)
+{
+    uint8_t r = d + s + carry;
+    set_flag(avr, SREG_H, (BIT(d, 3) & BIT(s, 3)) | (BIT(s, 3) & NBIT(r, 3)) | (NBIT(r, 3) & BIT(d, 3)));
+    set_flag(avr, SREG_V, (BIT(d, 7) & BIT(s, 7) & NBIT(r, 7)) | (NBIT(d, 7) & NBIT(s, 7) & BIT(r, 7)));
+    set_flag(avr, SREG_C, (BIT(d, 7) & BIT(s, 7)) | (BIT(s, 7) & NBIT(r, 7)) | (NBIT(r, 7) & BIT(d, 7)));
+    flags_nzs(avr, r);
+    return r;
+}
+
+// keep_z: SBC/SBCI/CPC only clear Z, never set it
+static uint8_t op_sub(avr_t *avr, uint8_t d, uint8_t s, int carry, int keep_z)
+{
+    uint8_t r = d - s - carry;
+    int z = flag(avr, SREG_Z);
+    set_flag(avr, SREG_H, (NBIT(d, 3) & BIT(s, 3)) | (BIT(s, 3) & BIT(r, 3)) | (BIT(r, 3) & NBIT(d, 3)));
+    set_flag(avr, SREG_V, (BIT(d, 7) & NBIT(s, 7) & NBIT(r, 7)) | (NBIT(d, 7) & BIT(s, 7) & BIT(r, 7)));
+    set_flag(avr, SREG_C, (NBIT(d, 7) & BIT(s, 7)) | (BIT(s, 7) & BIT(r, 7)) | (BIT(r, 7) & NBIT(d, 7)));
+    flags_nzs(avr, r);
+    if (keep_z)
+        set_flag(avr, SREG_Z, r == 0 && z);
+    return r;
+}
+
+static uint8_t op_logic(avr_t *avr, uint8_t r)
+{
+    set_flag(avr, SREG_V, 0);
+    flags_nzs(avr, r);
+    return r;
+}
+
+static uint8_t op_shift_right(avr_t *avr, uint8_t d, uint8_t top)
+{
+    uint8_t r = (d >> 1) | top;
+    set_flag(avr, SREG_C, d & 1);
+    set_flag(avr, SREG_N, BIT(r, 7));
+    set_flag(avr, SREG_V, flag(avr, SREG_N) ^ flag(avr, SREG_C));
+    flags_nzs(avr, r);
+    return r;
+}
+
+static void fault(avr_t *avr, const char *what, uint16_t op)
+{
+    snprintf(avr->error, sizeof(avr->error), "%s 0x%04x at 0x%04x", what, op, avr->pc * 2);
+    avr->stopped = 1;
+}
+
+// X, Y and Z are r26:27, r28:29 and r30:31
+static uint16_t ptr(const avr_t *avr, int reg)
+{
+    return avr->r[reg] | avr->r[reg + 1] << 8;
+}
+
+static void set_ptr(avr_t *avr, int reg, uint16_t v)
+{
+    avr->r[reg] = v;
+    avr->r[reg + 1] = v >> 8;
+}
+
+// LD/ST through X/Y/Z with optional post-increment/pre-decrement
+static unsigned ld_st(avr_t *avr, uint16_t op, int store)
+{
+    int d = (op >> 4) & 0x1F;
+    int mode = op & 0x0F;
+    int reg, inc = 0, dec = 0;
+    unsigned cycles = 1, extra = 0;
+
+    if ((op & 0xFC00) == 0x8000) // LD/ST Y or Z without displacement
+        reg = (mode & 0x08) ? 28 : 30;
+    else
+    {
+        switch (mode)
+        {
+        case 0x1: reg = 30; inc = 1; break;
+        case 0x2: reg = 30; dec = 1; break;
+        case 0x9: reg = 28; inc = 1; break;
+        case 0xA: reg = 28; dec = 1; break;
+        case 0xC: reg = 26; break;
+        case 0xD: reg = 26; inc = 1; break;
+        case 0xE: reg = 26; dec = 1; break;
+        default:
+            fault(avr, "unknown opcode", op);
+            return 1;
+        }
+    }
+
+    uint16_t a = ptr(avr, reg);
+    if (dec)
+    {
+        a--;
+        cycles++;
+    }
+    if (store)
+        data_write(avr, a, avr->r[d]);
+    else
+        avr->r[d] = data_read(avr, a, &extra);
+    if (inc)
+        a++;
+    if (inc || dec)
+        set_ptr(avr, reg, a);
+    return cycles + extra;
+}
+
+// Reduced core LDS/STS: 7 bit address scattered over the opcode
+static uint16_t lds_address(uint16_t op)
+{
+    uint16_t a = (op & 0x0F) | ((op >> 5) & 0x30) | ((op >> 2) & 0x40);
+    return a | (!(op & 0x0100)) << 7;
+}
+
+// r0-r15 don't exist on the reduced core, catch code built for another part
+static int uses_low_register(uint16_t op, int d, int s)
+{
+    if (op >= 0x0400 && op < 0x3000)
+        return d < 16 || s < 16;
+    if ((op & 0xF000) == 0x8000 || (op & 0xFC00) == 0x9000 || (op & 0xF000) == 0xB000 || (op & 0xF800) == 0xF800)
+        return d < 16;
+    if ((op & 0xFE00) == 0x9400 && ((op & 0x0F) < 0x08 || (op & 0x0F) == 0x0A))
+        return d < 16;
+    return 0;
+}
+
+static unsigned execute(avr_t *avr)
+{
+    uint16_t op = avr->flash[avr->pc & (AVR_FLASH_SIZE / 2 - 1)];
+    uint16_t next = avr->pc + 1;
+    unsigned cycles = 1;
+    uint8_t *r = avr->r;
+    int d = (op >> 4) & 0x1F;
+    int s = (op & 0x0F) | ((op >> 5) & 0x10);
+    int di = 16 + ((op >> 4) & 0x0F);
+    uint8_t k = (op & 0x0F) | ((op >> 4) & 0xF0);
+
+    if (uses_low_register(op, d, s))
+    {
+        fault(avr, "register below r16 in", op);
+        return 1;
+    }
+
+    switch (op >> 12)
+    {
+    case 0x0:
+        switch ((op >> 10) & 3)
+        {
+        case 0:
+            if (op != 0)
+                fault(avr, "unknown opcode", op);
+            break; // NOP
+        case 1: op_sub(avr, r[d], r[s], flag(avr, SREG_C), 1); break; // CPC
+        case 2: r[d] = op_sub(avr, r[d], r[s], flag(avr, SREG_C), 1); break; // SBC
+        case 3: r[d] = op_add(avr, r[d], r[s], 0); break; // ADD
+        }
+        break;
+    case 0x1:
+        switch ((op >> 10) & 3)
+        {
+        case 0: // CPSE
+            if (r[d] == r[s])
+            {
+                next++;
+                cycles++;
+            }
+            break;
+        case 1: op_sub(avr, r[d], r[s], 0, 0); break; // CP
+        case 2: r[d] = op_sub(avr, r[d], r[s], 0, 0); break; // SUB
+        case 3: r[d] = op_add(avr, r[d], r[s], flag(avr, SREG_C)); break; // ADC
+        }
+        break;
+    case 0x2:
+        switch ((op >> 10) & 3)
+        {
+        case 0: r[d] = op_logic(avr, r[d] & r[s]); break; // AND
+        case 1: r[d] = op_logic(avr, r[d] ^ r[s]); break; // EOR
+        case 2: r[d] = op_logic(avr, r[d] | r[s]); break; // OR
+        case 3: r[d] = r[s]; break; // MOV
+        }
+        break;
+    case 0x3: op_sub(avr, r[di], k, 0, 0); break; // CPI
+    case 0x4: r[di] = op_sub(avr, r[di], k, flag(avr, SREG_C), 1); break; // SBCI
+    case 0x5: r[di] = op_sub(avr, r[di], k, 0, 0); break; // SUBI
+    case 0x6: r[di] = op_logic(avr, r[di] | k); break; // ORI
+    case 0x7: r[di] = op_logic(avr, r[di] & k); break; // ANDI
+    case 0x8:
+        if (op & 0x0C07)
+            fault(avr, "unknown opcode", op); // LDD/STD with displacement
+        else
+            cycles = ld_st(avr, op, op & 0x0200);
+        break;
+    case 0x9:
+        switch ((op >> 8) & 0x0F)
+        {
+        case 0x0:
+        case 0x1:
+            if ((op & 0x0F) == 0x0F) // POP
+            {
+                r[d] = pop(avr);
+                cycles = 3;
+            }
+            else
+                cycles = ld_st(avr, op, 0);
+            break;
+        case 0x2:
+        case 0x3:
+            if ((op & 0x0F) == 0x0F) // PUSH
+                push(avr, r[d]);
+            else
+                cycles = ld_st(avr, op, 1);
+            break;
+        case 0x4:
+        case 0x5:
+            switch (op & 0x0F)
+            {
+            case 0x0: // COM
+                r[d] = op_logic(avr, ~r[d]);
+                set_flag(avr, SREG_C, 1);
+                break;
+            case 0x1: // NEG
+            {
+                uint8_t v = -r[d];
+                set_flag(avr, SREG_H, BIT(v, 3) | BIT(r[d], 3));
+                set_flag(avr, SREG_V, v == 0x80);
+                set_flag(avr, SREG_C, v != 0);
+                flags_nzs(avr, v);
+                r[d] = v;
+                break;
+            }
+            case 0x2: r[d] = (r[d] << 4) | (r[d] >> 4); break; // SWAP
+            case 0x3: // INC
+                r[d]++;
+                set_flag(avr, SREG_V, r[d] == 0x80);
+                flags_nzs(avr, r[d]);
+                break;
+            case 0x5: r[d] = op_shift_right(avr, r[d], r[d] & 0x80); break; // ASR
+            case 0x6: r[d] = op_shift_right(avr, r[d], 0); break; // LSR
+            case 0x7: r[d] = op_shift_right(avr, r[d], flag(avr, SREG_C) << 7); break; // ROR
+            case 0xA: // DEC
+                r[d]--;
+                set_flag(avr, SREG_V, r[d] == 0x7F);
+                flags_nzs(avr, r[d]);
+                break;
+            case 0x8:
+                if (op & 0x0100)
+                {
+                    switch (op)
+                    {
+                    case 0x9508: // RET
+                        next = pop_pc(avr);
+                        cycles = 6;
+                        avr->returned = 1;
+                        break;
+                    case 0x9518: // RETI
+                        next = pop_pc(avr);
+                        cycles = 6;
+                        set_flag(avr, SREG_I, 1);
+                        avr->irq_inhibit = 1;
+                        break;
+                    case 0x9588: // SLEEP
+                        if (avr->io[AVR_SMCR] & (1 << SE))
+                        {
+                            static const enum avr_state modes[8] = {
+                                AVR_IDLE, AVR_ADC_NR, AVR_POWER_DOWN, AVR_ACTIVE,
+                                AVR_STANDBY, AVR_ACTIVE, AVR_ACTIVE, AVR_ACTIVE};
+                            avr->state = modes[(avr->io[AVR_SMCR] >> 1) & 7];
+                            if (avr->state == AVR_ADC_NR && !avr->adc_running)
+                                adc_start(avr);
+                        }
+                        break;
+                    case 0x9598: // BREAK
+                        avr->stopped = 1;
+                        break;
+                    case 0x95A8: // WDR
+                        avr->wdt_start = avr->ticks;
+                        break;
+                    default:
+                        fault(avr, "unknown opcode", op);
+                    }
+                }
+                else if (op & 0x0080) // BCLR
+                    avr->io[AVR_SREG] &= ~(1 << ((op >> 4) & 7));
+                else // BSET
+                {
+                    avr->io[AVR_SREG] |= 1 << ((op >> 4) & 7);
+                    if (((op >> 4) & 7) == SREG_I)
+                        avr->irq_inhibit = 1;
+                }
+                break;
+            case 0x9:
+                if (op == 0x9409) // IJMP
+                {
+                    next = ptr(avr, 30);
+                    cycles = 2;
+                }
+                else if (op == 0x9509) // ICALL
+                {
+                    push_pc(avr, next);
+                    next = ptr(avr, 30);
+                    cycles = 3;
+                    if (avr->on_call)
+                        avr->on_call(avr->call_ctx, avr, next, sp_get(avr));
+                }
+                else
+                    fault(avr, "unknown opcode", op);
+                break;
+            default:
+                fault(avr, "unknown opcode", op);
+            }
+            break;
+        case 0x8: // CBI
+        case 0xA: // SBI
+        {
+            uint8_t a = (op >> 3) & 0x1F, bit = 1 << (op & 7);
+            uint8_t v = io_read(avr, a);
+            if (a == AVR_PINB)
+                v = 0; // only the written bit toggles
+            io_write(avr, a, (op & 0x0200) ? v | bit : v & ~bit);
+            break;
+        }
+        case 0x9: // SBIC
+        case 0xB: // SBIS
+        {
+            int set = BIT(io_read(avr, (op >> 3) & 0x1F), op & 7);
+            if (set == !!(op & 0x0200))
+            {
+                next++;
+                cycles = 2;
+            }
+            break;
+        }
+        default:
+            fault(avr, "unknown opcode", op); // MUL and friends
+        }
+        break;
+    case 0xA: // reduced core LDS/STS
+    {
+        uint16_t a = lds_address(op);
+        if (op & 0x0800)
+            data_write(avr, a, r[di]);
+        else
+            r[di] = data_read(avr, a, NULL);
+        break;
+    }
+    case 0xB:
+    {
+        uint8_t a = (op & 0x0F) | ((op >> 5) & 0x30);
+        if (op & 0x0800)
+            io_write(avr, a, r[d]); // OUT
+        else
+            r[d] = io_read(avr, a); // IN
+        break;
+    }
+    case 0xC: // RJMP
+    case 0xD: // RCALL
+    {
+        int16_t rel = (op & 0x0FFF) | ((op & 0x0800) ? 0xF000 : 0);
+        if (op & 0x1000)
+        {
+            push_pc(avr, next);
+            cycles = 4;
+        }
+        else
+            cycles = 2;
+        next += rel;
+        if ((op & 0x1000) && avr->on_call)
+            avr->on_call(avr->call_ctx, avr, next, sp_get(avr));
+        break;
+    }
+    case 0xE: r[di] = k; break; // LDI
+    case 0xF:
+        if (op & 0x0800)
+        {
+            int bit = op & 7;
+            if (op & 0x0008)
+                fault(avr, "unknown opcode", op);
+            else if ((op & 0x0C00) == 0x0C00) // SBRC/SBRS
+            {
+                if (BIT(r[d], bit) == !!(op & 0x0200))
+                {
+                    next++;
+                    cycles = 2;
+                }
+            }
+            else if (op & 0x0200) // BST
+                set_flag(avr, SREG_T, BIT(r[d], bit));
+            else // BLD
+                r[d] = (r[d] & ~(1 << bit)) | flag(avr, SREG_T) << bit;
+        }
+        else // BRBS/BRBC
+        {
+            int8_t rel = ((op >> 3) & 0x7F) | ((op & 0x0200) ? 0x80 : 0);
+            if (flag(avr, op & 7) == !(op & 0x0400))
+            {
+                next += rel;
+                cycles = 2;
+            }
+        }
+        break;
+    }
+
+    avr->pc = next & (AVR_FLASH_SIZE / 2 - 1);
+    return cycles;
+}
+
+int avr_step(avr_t *avr)
+{
+    if (avr->stopped)
+        return 0;
+
+    if (avr->state != AVR_ACTIVE)
+    {
+        int vect = pending_vector(avr);
+        if (!can_wake(avr, vect))
+        {
+            // nothing pending, sleep until the next peripheral event
+            uint64_t next = UINT64_MAX;
+            if (wdt_running(avr))
+                next = avr->wdt_start + wdt_period(avr);
+            if (avr->adc_running && avr->state != AVR_POWER_DOWN && avr->state != AVR_STANDBY && avr->adc_done < next)
+                next = avr->adc_done;
+            if (pin_watched(avr) && avr->ticks + PIN_POLL_TICKS < next)
+                next = avr->ticks + PIN_POLL_TICKS;
+            if (next == UINT64_MAX)
+            {
+                snprintf(avr->error, sizeof(avr->error), "asleep with nothing enabled to wake up");
+                avr->stopped = 1;
+                return 0;
+            }
+            advance(avr, next > avr->ticks ? next - avr->ticks : 0);
+            return 1;
+        }
+
+        enum avr_state was = avr->state;
+        avr->state = AVR_ACTIVE;
+        avr->wakeups++;
+        spend(avr, WAKE_HALT_CYCLES + (was == AVR_POWER_DOWN || was == AVR_STANDBY ? STARTUP_CYCLES : 0));
+        if (!flag(avr, SREG_I))
+            return 1; // woken, carries on after SLEEP
+    }
+
+    if (avr->irq_inhibit)
+        avr->irq_inhibit--;
+    else if (flag(avr, SREG_I))
+    {
+        int vect = pending_vector(avr);
+        if (vect)
+        {
+            // the flag is cleared by hardware when the vector is taken
+            if (vect == AVR_VECT_WDT)
+                avr->io[AVR_WDTCSR] &= ~(1 << WDIF);
+            else if (vect == AVR_VECT_ADC)
+                avr->io[AVR_ADCSRA] &= ~(1 << ADIF);
+            else if (vect == AVR_VECT_PCINT0)
+                avr->io[AVR_PCIFR] &= ~1;
+            avr->irqs[vect]++;
+            push_pc(avr, avr->pc);
+            set_flag(avr, SREG_I, 0);
+            avr->pc = vect;
+            spend(avr, IRQ_CYCLES);
+            return 1;
+        }
+    }
+
+    spend(avr, execute(avr));
+    if (avr->returned)
+    {
+        avr->returned = 0;
+        if (avr->on_ret)
+            avr->on_ret(avr->call_ctx, avr, sp_get(avr));
+    }
+    return !avr->stopped;
+}
+
+void avr_run_until(avr_t *avr, uint64_t ticks)
+{
+    while (avr->ticks < ticks && avr_step(avr))
+        ;
+}
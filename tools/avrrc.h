@@ -0,0 +1,169 @@
+#ifndef AVRRC_H
+#define AVRRC_H
+
+/*
+Host-side model of the AVR reduced core (AVRrc) as found in the
+ATtiny4/5/9/10: 16 registers (r16-r31), no MUL/LPM/ADIW, 1 word
+instructions only and the reduced LDS/STS encoding.
+
+Timing follows the AVRrc column of the AVR instruction set manual:
+SBI/CBI, LD, ST, PUSH, LDS and STS take 1 cycle, LD from the flash
+mapped at 0x4000 and the pre-decrement forms take one more, POP takes 3,
+RCALL 4, ICALL 3, RET and RETI 6. Taking an interrupt costs 4 cycles,
+plus 4 halted cycles and the oscillator start-up when it wakes the core.
+
+Time is kept in periods of the 8 MHz internal oscillator (125 ns), so a
+CPU cycle is 1 << CLKPSR ticks and the 128 kHz watchdog's 16 ms period
+is exactly 128000 ticks. While the core sleeps the model skips ahead to
+the next peripheral event instead of ticking through it.
+
+Peripherals modelled: CCP, CLKPSR, SMCR/sleep, the watchdog interrupt,
+the ADC (single, noise-reduction triggered and free running), PORTB and
+the PB0 pin change interrupt, with PB0 reading the photoresistor divider
+that PB1 powers.
+*/
+
+#include <stdint.h>
+
+#define AVR_OSC_HZ 8000000
+#define AVR_TICK_NS 125
+
+#define AVR_FLASH_SIZE 1024 // ATtiny9/10, ATtiny4/5 use the first 512
+#define AVR_SRAM_START 0x40
+#define AVR_SRAM_SIZE 32
+#define AVR_FLASH_MAP 0x4000 // flash as seen from the data space
+
+// I/O register addresses (same in I/O and data space on the reduced core)
+#define AVR_PINB 0x00
+#define AVR_DDRB 0x01
+#define AVR_PORTB 0x02
+#define AVR_PUEB 0x03
+#define AVR_PCMSK 0x10
+#define AVR_PCIFR 0x11
+#define AVR_PCICR 0x12
+#define AVR_DIDR0 0x17
+#define AVR_ADCL 0x19
+#define AVR_ADMUX 0x1B
+#define AVR_ADCSRB 0x1C
+#define AVR_ADCSRA 0x1D
+#define AVR_ACSR 0x1F
+#define AVR_WDTCSR 0x31
+#define AVR_PRR 0x35
+#define AVR_CLKPSR 0x36
+#define AVR_CLKMSR 0x37
+#define AVR_SMCR 0x3A
+#define AVR_CCP 0x3C
+#define AVR_SPL 0x3D
+#define AVR_SPH 0x3E
+#define AVR_SREG 0x3F
+
+// Interrupt vectors (word addresses)
+#define AVR_VECT_PCINT0 2
+#define AVR_VECT_ANA_COMP 7
+#define AVR_VECT_WDT 8
+#define AVR_VECT_ADC 10
+#define AVR_VECTORS 11
+
+enum avr_state
+{
+    AVR_ACTIVE,
+    AVR_IDLE,
+    AVR_ADC_NR,
+    AVR_POWER_DOWN,
+    AVR_STANDBY,
+    AVR_STATES
+};
+
+extern const char *const avr_state_names[AVR_STATES];
+
+typedef struct avr avr_t;
+
+struct avr
+{
+    uint16_t flash[AVR_FLASH_SIZE / 2];
+    uint16_t flash_size; // bytes loaded
+    uint8_t r[32];       // only r16-r31 exist
+    uint8_t io[64];
+    uint8_t sram[AVR_SRAM_SIZE];
+    uint16_t pc; // word address
+
+    uint8_t sram_static; // bytes of .data and .bss, from the ELF's sections
+    uint16_t sp_min;     // lowest SP since avr_init, the stack's deepest point
+
+    enum avr_state state;
+    uint64_t ticks;  // 8 MHz oscillator periods since reset
+    uint64_t cycles; // CPU cycles executed or halted, not slept
+    uint64_t state_ticks[AVR_STATES];
+    uint64_t wakeups;
+    uint64_t irqs[AVR_VECTORS];
+
+    uint64_t ccp_until; // protected registers writable before this cycle
+    int irq_inhibit;    // SEI and RETI let one more instruction run
+
+    uint64_t wdt_start; // tick the watchdog counter last restarted
+    int adc_running;
+    int adc_first; // first conversion after ADEN takes 25 ADC clocks
+    uint64_t adc_done;
+    uint8_t adc_value;
+    int pb0_in; // PB0 digital input as last latched
+
+    // light level on PB0 with the divider powered, 0..255
+    uint8_t (*light)(void *ctx, uint64_t ticks);
+    void *light_ctx;
+
+    // PORTB register changed, called after the instruction's cycles
+    void (*on_portb)(void *ctx, avr_t *avr, uint8_t old, uint8_t now);
+    void *portb_ctx;
+
+    // RCALL/ICALL into target, before its cycles are counted, and RET
+    // once they are, with SP after the push/pop
+    void (*on_call)(void *ctx, avr_t *avr, uint16_t target, uint16_t sp);
+    void (*on_ret)(void *ctx, avr_t *avr, uint16_t sp);
+    void *call_ctx;
+    int returned;
+
+    int stopped; // BREAK, a fault or a sleep nothing can wake
+    char error[96];
+};
+
+typedef struct
+{
+    char name[48];
+    uint32_t addr; // byte address, flash symbols below 0x800000
+    uint32_t size;
+    int func;
+} avr_sym_t;
+
+typedef struct
+{
+    avr_sym_t *sym;
+    int count;
+} avr_syms_t;
+
+void avr_init(avr_t *avr);
+void avr_reset(avr_t *avr);
+
+// Load an ELF (symbols optional, may be NULL) or an Intel HEX file,
+// returns 0 on success and prints the reason otherwise
+int avr_load(avr_t *avr, const char *path, avr_syms_t *syms);
+const avr_sym_t *avr_sym_find(const avr_syms_t *syms, const char *name);
+void avr_syms_free(avr_syms_t *syms);
+
+// Execute one instruction, take one interrupt or, while asleep, skip to
+// the next event. Returns 0 once the core has stopped.
+int avr_step(avr_t *avr);
+void avr_run_until(avr_t *avr, uint64_t ticks);
+
+// CPU clock divider currently selected through CLKPSR
+static inline unsigned avr_clkps(const avr_t *avr)
+{
+    unsigned ps = avr->io[AVR_CLKPSR] & 0x0F;
+    return ps > 8 ? 8 : ps;
+}
+
+static inline double avr_seconds(uint64_t ticks)
+{
+    return ticks / (double)AVR_OSC_HZ;
+}
+
+#endif
@@ -0,0 +1,223 @@
+/*
+Run a throwie2 image on the AVR reduced core model and report where the
+time and cycles went.
+
+    avrsim [options] avrgcc/throwie2.elf
+
+    -t TIME   simulated time, seconds or with an m/h suffix (default 60)
+    -l LEVEL  constant light level on PB0, 0..255, higher is darker
+              (default 200, dark enough for every effect to run)
+    -L FILE   light trace instead, see light.h for the format
+    -p        print every PORTB change with its cycle and time stamp
+    -f NAME   cycles per call of function NAME, can be repeated (ELF only)
+    -r        fail when .data and .bss plus the deepest stack seen don't
+              fit in the 32 bytes of SRAM together (ELF only)
+*/
+
+#include "avrrc.h"
+#include "light.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_PROFILES 8
+#define MAX_DEPTH 8
+
+typedef struct
+{
+    const char *name;
+    uint16_t entry; // word address
+    uint64_t calls, min, max, total;
+    uint64_t total_ticks;
+    int depth;
+    uint16_t sp[MAX_DEPTH];
+    uint64_t start[MAX_DEPTH], start_ticks[MAX_DEPTH];
+} profile_t;
+
+typedef struct
+{
+    profile_t p[MAX_PROFILES];
+    int count;
+} profiles_t;
+
+static void on_call(void *ctx, avr_t *avr, uint16_t target, uint16_t sp)
+{
+    profiles_t *profiles = ctx;
+
+    for (int i = 0; i < profiles->count; i++)
+    {
+        profile_t *p = &profiles->p[i];
+        if (p->entry != target || p->depth == MAX_DEPTH)
+            continue;
+        p->sp[p->depth] = sp + 2; // SP once the return address is popped
+        p->start[p->depth] = avr->cycles;
+        p->start_ticks[p->depth] = avr->ticks;
+        p->depth++;
+    }
+}
+
+static void on_ret(void *ctx, avr_t *avr, uint16_t sp)
+{
+    profiles_t *profiles = ctx;
+
+    for (int i = 0; i < profiles->count; i++)
+    {
+        profile_t *p = &profiles->p[i];
+        if (!p->depth || p->sp[p->depth - 1] != sp)
+            continue;
+        p->depth--;
+        // from the start of the RCALL to the end of the RET
+        uint64_t cycles = avr->cycles - p->start[p->depth];
+        p->calls++;
+        p->total += cycles;
+        p->total_ticks += avr->ticks - p->start_ticks[p->depth];
+        if (p->calls == 1 || cycles < p->min)
+            p->min = cycles;
+        if (cycles > p->max)
+            p->max = cycles;
+    }
+}
+
+static void on_portb(void *ctx, avr_t *avr, uint8_t old, uint8_t now)
+{
+    (void)ctx;
+    (void)old;
+    printf("%12llu cycles %14.6f ms  PORTB %c%c%c%c\n",
+           (unsigned long long)avr->cycles, avr->ticks * (AVR_TICK_NS / 1e6),
+           now & 8 ? '1' : '0', now & 4 ? '1' : '0', now & 2 ? '1' : '0', now & 1 ? '1' : '0');
+}
+
+static double parse_time(const char *s)
+{
+    char *end;
+    double t = strtod(s, &end);
+    if (*end == 'h')
+        t *= 3600;
+    else if (*end == 'm')
+        t *= 60;
+    return t;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: avrsim [-t time] [-l level | -L trace] [-p] [-r] [-f function]... firmware.elf|.hex\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    static avr_t avr;
+    avr_syms_t syms = {0};
+    light_t light = {0};
+    profiles_t profiles = {0};
+    double seconds = 60;
+    int opt, print_port = 0, check_ram = 0;
+    const char *trace = NULL;
+
+    light_constant(&light, 200);
+
+    while ((opt = getopt(argc, argv, "t:l:L:prf:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            seconds = parse_time(optarg);
+            break;
+        case 'l':
+            light_free(&light);
+            light_constant(&light, atof(optarg));
+            break;
+        case 'L':
+            trace = optarg;
+            break;
+        case 'p':
+            print_port = 1;
+            break;
+        case 'r':
+            check_ram = 1;
+            break;
+        case 'f':
+            if (profiles.count == MAX_PROFILES)
+                usage();
+            profiles.p[profiles.count++].name = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind + 1 != argc)
+        usage();
+
+    if (trace)
+    {
+        light_free(&light);
+        if (light_load(&light, trace))
+            return 1;
+    }
+
+    avr_init(&avr);
+    if (avr_load(&avr, argv[optind], &syms))
+        return 1;
+
+    for (int i = 0; i < profiles.count; i++)
+    {
+        const avr_sym_t *sym = avr_sym_find(&syms, profiles.p[i].name);
+        if (!sym || !sym->func)
+        {
+            fprintf(stderr, "%s: no function %s (inlined, or not an ELF?)\n", argv[optind], profiles.p[i].name);
+            return 1;
+        }
+        profiles.p[i].entry = sym->addr / 2;
+    }
+
+    avr.light = light_avr;
+    avr.light_ctx = &light;
+    avr.on_call = on_call;
+    avr.on_ret = on_ret;
+    avr.call_ctx = &profiles;
+    if (print_port)
+        avr.on_portb = on_portb;
+
+    avr_run_until(&avr, (uint64_t)(seconds * AVR_OSC_HZ));
+
+    if (avr.error[0])
+        fprintf(stderr, "%s: stopped: %s\n", argv[optind], avr.error);
+
+    printf("%s: %.6f s simulated, %llu bytes of flash, %llu cycles\n", argv[optind],
+           avr_seconds(avr.ticks), (unsigned long long)avr.flash_size, (unsigned long long)avr.cycles);
+    for (int s = 0; s < AVR_STATES; s++)
+    {
+        if (!avr.state_ticks[s])
+            continue;
+        printf("  %-20s %14.6f s %8.4f%%\n", avr_state_names[s], avr_seconds(avr.state_ticks[s]),
+               100.0 * avr.state_ticks[s] / (avr.ticks ? avr.ticks : 1));
+    }
+    printf("  wakeups %llu, %.1f cycles awake per wakeup\n", (unsigned long long)avr.wakeups,
+           avr.wakeups ? (double)avr.cycles / avr.wakeups : 0.0);
+    printf("  interrupts: WDT %llu, ADC %llu, PCINT0 %llu\n", (unsigned long long)avr.irqs[AVR_VECT_WDT],
+           (unsigned long long)avr.irqs[AVR_VECT_ADC], (unsigned long long)avr.irqs[AVR_VECT_PCINT0]);
+
+    int stack = AVR_SRAM_START + AVR_SRAM_SIZE - 1 - avr.sp_min;
+    int ram_over = avr.sram_static + stack > AVR_SRAM_SIZE;
+    printf("  SRAM: %d bytes .data/.bss + %d stack of %d%s\n", avr.sram_static, stack, AVR_SRAM_SIZE,
+           ram_over ? ", overflows" : "");
+
+    for (int i = 0; i < profiles.count; i++)
+    {
+        profile_t *p = &profiles.p[i];
+        if (!p->calls)
+        {
+            printf("  %s: not called\n", p->name);
+            continue;
+        }
+        printf("  %s: %llu calls, cycles min %llu max %llu avg %.1f, %.3f us avg\n", p->name,
+               (unsigned long long)p->calls, (unsigned long long)p->min, (unsigned long long)p->max,
+               (double)p->total / p->calls, p->total_ticks * (AVR_TICK_NS / 1e3) / p->calls);
+    }
+
+    avr_syms_free(&syms);
+    light_free(&light);
+    return avr.error[0] || (check_ram && ram_over) ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+/*
+Sample curves into the flash tables curve16() interpolates, at build time.
+
+    curves [-e BITS] [-b BITS] [-g BITS] [-G GAMMA] > avrgcc/curves.h
+
+    -e BITS   ease_table, the cubic S-curve 3x^2 - 2x^3 that lib8tion's
+              ease16InOutApprox() approximates with straight lines,
+              2^BITS + 1 points (default 4)
+    -b BITS   breath_table, the rising half of exp(sin(t)), the usual
+              "breathing LED" envelope, scaled to 0..1 (default 4)
+    -g BITS   gamma_table, x^GAMMA, perceived brightness to LED duty
+              (default 4)
+    -G GAMMA  the exponent (default 2.2)
+
+BITS is 1 to 8, a table is 2^(BITS + 1) + 2 bytes. Every table's size
+and the largest error of curve16() against the exact curve, over all
+65536 inputs and in 8-bit steps and % of full scale, go to stderr, so
+the build log says what each table costs and buys. Only the tables an
+image uses are linked into it.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../curve.h"
+
+static double gamma_exp = 2.2;
+
+// lib8tion's ease8InOutCubic(), 3x^2 - 2x^3
+static double ease(double x)
+{
+    return x * x * (3 - 2 * x);
+}
+
+static double breath(double x)
+{
+    return (exp(sin(M_PI * (x - 0.5))) - exp(-1)) / (exp(1) - exp(-1));
+}
+
+static double gamma_(double x)
+{
+    return pow(x, gamma_exp);
+}
+
+typedef struct
+{
+    const char *name;
+    const char *macro; // NAME_TABLE_BITS
+    double (*f)(double x);
+    int bits;
+    const char *what;
+} curve_t;
+
+static curve_t curves[] = {
+    {"ease", "EASE", ease, 4, "cubic ease-in/out, 3x^2 - 2x^3"},
+    {"breath", "BREATH", breath, 4, "exp(sin) breath, rising half"},
+    {"gamma", "GAMMA", gamma_, 4, "x^gamma"},
+};
+
+#define CURVES (sizeof(curves) / sizeof(curves[0]))
+
+static void emit(const curve_t *c)
+{
+    int points = (1 << c->bits) + 1;
+    uint16_t table[257];
+    double max = 0;
+    unsigned at = 0;
+
+    for (int i = 0; i < points; i++)
+        table[i] = lround(65535 * c->f((double)i / (points - 1)));
+    for (int i = 1; i < points; i++)
+    {
+        if (table[i] < table[i - 1])
+        {
+            fprintf(stderr, "curves: %s falls between points %d and %d\n", c->name, i - 1, i);
+            exit(1);
+        }
+    }
+
+    for (unsigned x = 0; x < 65536; x++)
+    {
+        double err = fabs(curve16(table, x, c->bits) - 65535 * c->f(x / 65535.0));
+        if (err > max)
+        {
+            max = err;
+            at = x;
+        }
+    }
+
+    if (c->f == gamma_)
+        printf("// %s, gamma %.2f, %d points, up to %.2f steps of 8 bits off\n", c->what, gamma_exp, points,
+               max / 257);
+    else
+        printf("// %s, %d points, up to %.2f steps of 8 bits off\n", c->what, points, max / 257);
+    printf("#define %s_TABLE_BITS %d\n", c->macro, c->bits);
+    if (c->f == gamma_)
+        printf("#define GAMMA_TABLE_EXP %g\n", gamma_exp);
+    printf("const uint16_t %s_table[] PROGMEM = {", c->name);
+    for (int i = 0; i < points; i++)
+        printf("%s%u,", i % 8 ? " " : "\n    ", table[i]);
+    printf("\n};\n\n");
+
+    fprintf(stderr, "curves: %-6s %3d points %4d bytes, max error %.2f steps (%.2f%%) at 0x%04x\n", c->name,
+            points, points * 2, max / 257, 100 * max / 65535, at);
+}
+
+static int bits(const char *s)
+{
+    int b = atoi(s);
+    if (b < 1 || b > 8)
+    {
+        fprintf(stderr, "curves: BITS must be 1 to 8, not %s\n", s);
+        exit(2);
+    }
+    return b;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: curves [-e bits] [-b bits] [-g bits] [-G gamma] > curves.h\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "e:b:g:G:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'e':
+            curves[0].bits = bits(optarg);
+            break;
+        case 'b':
+            curves[1].bits = bits(optarg);
+            break;
+        case 'g':
+            curves[2].bits = bits(optarg);
+            break;
+        case 'G':
+            gamma_exp = atof(optarg);
+            if (gamma_exp < 1 || gamma_exp > 4)
+            {
+                fprintf(stderr, "curves: GAMMA must be 1 to 4\n");
+                return 2;
+            }
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc)
+        usage();
+
+    printf("// Generated by tools/curves, don't edit\n\n");
+    for (size_t c = 0; c < CURVES; c++)
+        emit(&curves[c]);
+    return 0;
+}
@@ -0,0 +1,454 @@
+/*
+Charge a throwie2 image draws per night on the AVR reduced core model and
+the coin cell life that gives, with an optional regression gate.
+
+    energy [options] avrgcc/BREATHE.elf avrgcc/FLICKER.elf ...
+
+    -L FILE   light profile (default tools/night.light), see light.h
+    -t TIME   simulated time, seconds or with an m/h suffix (default the
+              profile's length)
+    -c MAH    battery capacity (default 225, a CR2032)
+    -r OHMS   photoresistor divider seen from PB1 (default 100k)
+    -q UA     SK6803 quiescent current per pixel (default 300)
+    -g FILE   compare against the results in FILE and exit with 1 when an
+              image draws more than the slack above them, isn't in FILE,
+              or FILE doesn't exist
+    -s PCT    slack for -g (default 2)
+    -u        write the results to the -g FILE whatever they are, which
+              is how a baseline is made the first time (see build.sh)
+
+Every image runs the same profile from reset. The current is a model of
+what the core, its peripherals and the LED draw at 3 V, integrated over
+the emulated time between instructions and sleep events:
+
+    core      by sleep state, active scaled with the CLKPSR clock
+    ADC       while ADEN is set
+    comp      while the analog comparator isn't disabled (ACSR.ACD)
+    divider   3 V / the -r resistance while PB1 drives it high
+    LED       each SK6803 channel in proportion to the value latched
+              into it, plus the quiescent current of every pixel
+
+The core figures are typical ATtiny4/5/9/10 datasheet values and the LED
+ones a guess for a low current part, so the absolute numbers are an
+estimate, the difference between two builds is what the gate is for. The
+emulator is deterministic, so any change in the result is a change in
+the firmware.
+
+Results are scaled to 24 hours of the profile, which is what a night
+means here: one dark period and the day around it.
+*/
+
+#include "avrrc.h"
+#include "light.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LED_PIN 2
+#define DIVIDER_PIN 1
+
+// Peripheral bits used by the model
+#define WDIE 6
+#define WDE 3
+#define ADEN 7
+#define ACD 7
+
+// Core at 3 V. Active is about BASE + PER_MHZ * f, which gives the
+// datasheet's 1.8 mA at 8 MHz and 0.35 mA at 1 MHz, idle about a
+// quarter of that. ADC noise reduction stops the CPU and I/O clocks too.
+#define ACTIVE_UA_BASE 143.0
+#define ACTIVE_UA_PER_MHZ 207.0
+#define IDLE_SHARE 0.25
+#define ADC_NR_UA 100.0
+#define POWER_DOWN_WDT_UA 4.5
+#define POWER_DOWN_UA 0.15
+#define ADC_UA 200.0
+#define COMPARATOR_UA 25.0
+#define VCC 3.0
+
+// SK6803, per channel at 255
+#define LED_CHANNEL_UA 5000.0
+#define LED_MAX_BYTES (8 * 3)
+#define T1H_MIN_NS 450 // between T0H and T1H
+#define RESET_NS 80000
+
+#define NIGHT_SECONDS 86400.0
+
+enum part
+{
+    PART_ACTIVE,
+    PART_IDLE,
+    PART_ADC_NR,
+    PART_POWER_DOWN,
+    PART_ADC,
+    PART_COMPARATOR,
+    PART_DIVIDER,
+    PART_LED,
+    PART_LED_IDLE,
+    PARTS
+};
+
+static const char *const part_names[PARTS] = {"active", "idle", "adc nr", "power-down", "ADC",
+                                              "comparator", "divider", "LED", "LED quiescent"};
+
+// the LED parts are reported apart from the core's
+#define PART_CORE_END PART_LED
+
+typedef struct
+{
+    double divider_ua;
+    double led_idle_ua;
+
+    double charge[PARTS]; // uA ticks
+
+    // SK6803 data line decoder
+    uint64_t rise, fall;
+    int pending; // bits sent since the last latch
+    unsigned bits;
+    uint8_t bytes[LED_MAX_BYTES];
+    unsigned pixels;
+    double led_ua; // drive current of the frame latched last
+    uint64_t led_since;
+} meter_t;
+
+typedef struct
+{
+    char name[64];
+    double core, led; // uAh per night
+} result_t;
+
+static uint64_t ticks_ns(uint64_t ns)
+{
+    return ns / AVR_TICK_NS;
+}
+
+static void led_charge(meter_t *m, uint64_t until)
+{
+    m->charge[PART_LED] += m->led_ua * (until - m->led_since);
+    m->charge[PART_LED_IDLE] += m->led_idle_ua * m->pixels * (until - m->led_since);
+    m->led_since = until;
+}
+
+// The pixels take the frame once the line has been low for a reset
+static void led_latch(meter_t *m, uint64_t at)
+{
+    unsigned bytes = m->bits / 8;
+    double ua = 0;
+
+    led_charge(m, at);
+    for (unsigned i = 0; i < bytes && i < LED_MAX_BYTES; i++)
+        ua += LED_CHANNEL_UA * m->bytes[i] / 255;
+    if (bytes >= 3)
+        m->pixels = bytes / 3;
+    m->led_ua = ua;
+    m->pending = 0;
+    m->bits = 0;
+}
+
+static void led_poll(meter_t *m, const avr_t *avr)
+{
+    uint64_t reset = m->fall + ticks_ns(RESET_NS);
+
+    if (m->pending && avr->ticks >= reset && !(avr->io[AVR_PORTB] >> LED_PIN & 1))
+        led_latch(m, reset);
+}
+
+static void on_portb(void *ctx, avr_t *avr, uint8_t old, uint8_t now)
+{
+    meter_t *m = ctx;
+    int level = now >> LED_PIN & 1;
+
+    if (level == (old >> LED_PIN & 1))
+        return;
+
+    if (level)
+    {
+        led_poll(m, avr);
+        m->rise = avr->ticks;
+        return;
+    }
+
+    m->fall = avr->ticks;
+    if (m->bits < LED_MAX_BYTES * 8)
+    {
+        uint8_t *byte = &m->bytes[m->bits / 8];
+        int one = (m->fall - m->rise) * AVR_TICK_NS > T1H_MIN_NS;
+        *byte = *byte << 1 | one;
+    }
+    m->bits++;
+    m->pending = 1;
+}
+
+static void core_current(const avr_t *avr, const meter_t *m, double ua[PARTS])
+{
+    const uint8_t *io = avr->io;
+    double active = ACTIVE_UA_BASE + ACTIVE_UA_PER_MHZ * (AVR_OSC_HZ / 1e6) / (1 << avr_clkps(avr));
+
+    for (int p = 0; p < PART_CORE_END; p++)
+        ua[p] = 0;
+
+    switch (avr->state)
+    {
+    case AVR_ACTIVE:
+        ua[PART_ACTIVE] = active;
+        break;
+    case AVR_IDLE:
+        ua[PART_IDLE] = active * IDLE_SHARE;
+        break;
+    case AVR_ADC_NR:
+        ua[PART_ADC_NR] = ADC_NR_UA;
+        break;
+    default:
+        ua[PART_POWER_DOWN] = io[AVR_WDTCSR] & (1 << WDIE | 1 << WDE) ? POWER_DOWN_WDT_UA : POWER_DOWN_UA;
+        break;
+    }
+
+    if (io[AVR_ADCSRA] & (1 << ADEN))
+        ua[PART_ADC] = ADC_UA;
+    if (!(io[AVR_ACSR] & (1 << ACD)))
+        ua[PART_COMPARATOR] = COMPARATOR_UA;
+    if (io[AVR_DDRB] & io[AVR_PORTB] & (1 << DIVIDER_PIN))
+        ua[PART_DIVIDER] = m->divider_ua;
+}
+
+// uA ticks to uAh per night
+static double per_night(double charge, uint64_t ticks)
+{
+    return charge / AVR_OSC_HZ / 3600 * (NIGHT_SECONDS / avr_seconds(ticks));
+}
+
+static int run(const char *path, const light_t *light, double seconds, meter_t *m, result_t *r, double mah)
+{
+    static avr_t avr;
+    uint64_t end = (uint64_t)(seconds * AVR_OSC_HZ);
+    double ua[PARTS];
+
+    avr_init(&avr);
+    if (avr_load(&avr, path, NULL))
+        return -1;
+
+    avr.light = light_avr;
+    avr.light_ctx = (void *)light;
+    avr.on_portb = on_portb;
+    avr.portb_ctx = m;
+
+    while (avr.ticks < end)
+    {
+        uint64_t from = avr.ticks;
+
+        core_current(&avr, m, ua);
+        if (!avr_step(&avr))
+            break;
+
+        uint64_t to = avr.ticks < end ? avr.ticks : end;
+        for (int p = 0; p < PART_CORE_END; p++)
+            m->charge[p] += ua[p] * (to - from);
+        led_poll(m, &avr);
+    }
+    if (avr.ticks > end)
+        avr.ticks = end;
+    led_charge(m, avr.ticks);
+
+    if (avr.error[0])
+    {
+        fprintf(stderr, "%s: stopped: %s\n", path, avr.error);
+        return -1;
+    }
+
+    const char *base = strrchr(path, '/');
+    snprintf(r->name, sizeof(r->name), "%s", base ? base + 1 : path);
+    r->core = r->led = 0;
+    for (int p = 0; p < PARTS; p++)
+        *(p < PART_CORE_END ? &r->core : &r->led) += per_night(m->charge[p], avr.ticks);
+
+    printf("%s: %.1f h, %.2f uAh core + %.1f uAh LED per night, %.1f days on %.0f mAh\n", path,
+           avr_seconds(avr.ticks) / 3600, r->core, r->led, mah * 1000 / (r->core + r->led), mah);
+    for (int p = 0; p < PARTS; p++)
+    {
+        if (!m->charge[p])
+            continue;
+        printf("  %-14s %10.3f uAh  %8.3f uA avg\n", part_names[p], per_night(m->charge[p], avr.ticks),
+               m->charge[p] / avr.ticks);
+    }
+    return 0;
+}
+
+static int load_results(const char *path, result_t **out)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    int count = 0;
+
+    *out = NULL;
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f))
+    {
+        result_t r;
+        if (line[0] == '#' || sscanf(line, "%63s %lf %lf", r.name, &r.core, &r.led) != 3)
+            continue;
+        *out = realloc(*out, (count + 1) * sizeof(result_t));
+        (*out)[count++] = r;
+    }
+    fclose(f);
+    return count;
+}
+
+static int save_results(const char *path, const result_t *results, int count)
+{
+    FILE *f = fopen(path, "w");
+
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "# energy -g baseline: image, core and LED uAh per night\n");
+    for (int i = 0; i < count; i++)
+        fprintf(f, "%s %.3f %.3f\n", results[i].name, results[i].core, results[i].led);
+    fclose(f);
+    printf("results written to %s\n", path);
+    return 0;
+}
+
+static int over(const char *name, const char *what, double now, double was, double slack)
+{
+    double change = was ? 100 * (now - was) / was : 0;
+
+    if (now <= was * (1 + slack / 100))
+        return 0;
+    printf("  %s: %s %.3f uAh per night, %+.1f%% on %.3f\n", name, what, now, change, was);
+    return 1;
+}
+
+static int gate(const result_t *results, int count, const result_t *base, int base_count, double slack)
+{
+    int failed = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        const result_t *b = NULL;
+        for (int j = 0; j < base_count; j++)
+            if (!strcmp(base[j].name, results[i].name))
+                b = &base[j];
+        if (!b)
+        {
+            printf("  %s: not in the baseline, run with -u to add it\n", results[i].name);
+            failed = 1;
+            continue;
+        }
+        failed |= over(results[i].name, "core", results[i].core, b->core, slack);
+        failed |= over(results[i].name, "LED", results[i].led, b->led, slack);
+    }
+    return failed;
+}
+
+static double parse_time(const char *s)
+{
+    char *end;
+    double t = strtod(s, &end);
+    if (*end == 'h')
+        t *= 3600;
+    else if (*end == 'm')
+        t *= 60;
+    return t;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: energy [-L profile] [-t time] [-c mAh] [-r ohms] [-q uA] [-g baseline [-s pct] [-u]] "
+                    "firmware.elf|.hex...\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    light_t light = {0};
+    const char *profile = "tools/night.light", *baseline = NULL;
+    double seconds = 0, mah = 225, ohms = 100e3, led_idle_ua = 300, slack = 2;
+    int opt, update = 0, failed = 0;
+
+    while ((opt = getopt(argc, argv, "L:t:c:r:q:g:s:u")) != -1)
+    {
+        switch (opt)
+        {
+        case 'L':
+            profile = optarg;
+            break;
+        case 't':
+            seconds = parse_time(optarg);
+            break;
+        case 'c':
+            mah = atof(optarg);
+            break;
+        case 'r':
+            ohms = atof(optarg);
+            break;
+        case 'q':
+            led_idle_ua = atof(optarg);
+            break;
+        case 'g':
+            baseline = optarg;
+            break;
+        case 's':
+            slack = atof(optarg);
+            break;
+        case 'u':
+            update = 1;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind == argc || (update && !baseline) || ohms <= 0)
+        usage();
+
+    if (light_load(&light, profile))
+        return 1;
+    if (!seconds)
+        seconds = light_end(&light);
+    if (seconds <= 0)
+    {
+        fprintf(stderr, "%s: profile has no length, give one with -t\n", profile);
+        return 1;
+    }
+
+    int count = argc - optind;
+    result_t *results = calloc(count, sizeof(result_t));
+
+    for (int i = 0; i < count; i++)
+    {
+        meter_t m = {0};
+        m.divider_ua = VCC / ohms * 1e6;
+        m.led_idle_ua = led_idle_ua;
+        m.pixels = 1;
+        if (run(argv[optind + i], &light, seconds, &m, &results[i], mah))
+            failed = 1;
+    }
+
+    if (baseline && !failed)
+    {
+        result_t *base;
+        int base_count = load_results(baseline, &base);
+
+        if (update)
+            failed = save_results(baseline, results, count) != 0;
+        else if (base_count < 0)
+        {
+            printf("no baseline %s, run with -u to write it and commit it\n", baseline);
+            failed = 1;
+        }
+        else if (gate(results, count, base, base_count, slack))
+        {
+            printf("more than %.1f%% over %s, run with -u if that's intended\n", slack, baseline);
+            failed = 1;
+        }
+        free(base);
+    }
+
+    free(results);
+    light_free(&light);
+    return failed;
+}
@@ -0,0 +1,12 @@
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+// Stand-in for <avr/interrupt.h>: nothing interrupts the host build, the
+// ISRs are ordinary functions that never get called
+#define ISR(vector, ...) void vector(void)
+#define ISR_NAKED
+#define sei()
+#define cli()
+#define reti()
+
+#endif
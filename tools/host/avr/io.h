@@ -0,0 +1,55 @@
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+/*
+Stand-in for avr-libc's <avr/io.h> in the host build of main.c (see
+tools/host/host.c). The registers main.c uses are plain variables that
+host.c looks at when the firmware sleeps, PINB is computed from the
+light trace whenever it's read. Bit numbers are the ATtiny5's.
+*/
+
+#include <stdint.h>
+
+// host.c has the real main() and calls the firmware's once it's set up
+#define main throwie_main
+
+extern volatile uint8_t PORTB, DDRB, PUEB, CCP, CLKPSR, WDTCSR, SMCR, PRR, ACSR;
+extern volatile uint8_t ADCSRA, ADCSRB, ADMUX, ADCL, DIDR0, PCMSK, PCICR, PCIFR;
+
+uint8_t host_pinb(void);
+#define PINB (host_pinb())
+
+// update_led() under HOST
+void host_frame(const uint8_t *color, uint8_t size);
+
+#define PINB0 0
+#define PORTB1 1
+
+#define PCINT0 0
+#define PCIE0 0
+
+#define WDIF 7
+#define WDIE 6
+#define WDP3 5
+#define WDE 3
+
+#define SM2 3
+#define SM1 2
+#define SM0 1
+#define SE 0
+
+#define PRADC 1
+#define PRTIM0 0
+
+#define ACD 7
+
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+
+#define ADC1D 1
+#define ADC0D 0
+
+#endif
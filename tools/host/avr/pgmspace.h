@@ -0,0 +1,8 @@
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+// Stand-in for <avr/pgmspace.h>, the reduced core reads flash through
+// the data space, so PROGMEM data is used directly like on the host
+#define PROGMEM
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+// Stand-in for <avr/sleep.h>, sleeping is where host.c moves virtual time
+void host_sleep(void);
+#define sleep_cpu() host_sleep()
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef HOST_AVR_WDT_H
+#define HOST_AVR_WDT_H
+
+// Stand-in for <avr/wdt.h>, host.c restarts the watchdog period at every
+// sleep anyway
+#define wdt_reset()
+
+#endif
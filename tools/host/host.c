@@ -0,0 +1,293 @@
+/*
+Virtual throwie2: main.c compiled for the host against the stand-in
+headers in tools/host/avr, with the peripherals replaced by a model that
+only acts when the firmware sleeps. Code runs in no time, each sleep
+moves virtual time on by what would have woken the core:
+
+    power down      a watchdog period (16 ms << WDP), or with the pin
+                    change interrupt armed, until PB0 crosses its input
+                    threshold
+    ADC noise red.  one conversion, 25 ADC clocks after a sleep that
+                    wasn't a conversion, 13 otherwise; ADCL then holds
+                    the light level if PB1 powers the divider
+
+and every update_led() writes the frame to a CSV with its virtual time
+and what the firmware's millis said at the time, so millis drift shows
+as the difference. A night of any effect takes well under a second,
+with the cycle accuracy left to avrsim.
+
+    throwie2-host [options] > frames.csv
+
+    -t TIME   virtual time, seconds or with an m/h suffix (default the
+              trace's length, 12 h for a constant level)
+    -l LEVEL  constant light level on PB0, 0..255, higher is darker
+              (default 200, dark enough for every effect to run)
+    -L FILE   light trace instead, see light.h
+    -o FILE   write the frames there instead of stdout
+    -d        fail when a run starts lit: a frame after more than a
+              second without one, when the last was off, has to be
+              dark too, no channel above DARK_MAX (an unchanged frame
+              isn't sent, so a ramp up from 0 shows its second step
+              first). For effects that start from dark, as
+              tools/patterns/breathe.pat does, it catches one that picks
+              up where the run before it left off
+
+Build with -DHOST -Itools/host and one effect, see build.sh.
+*/
+
+#include "avr/io.h"
+#include "../light.h"
+
+#undef main
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// same as the emulator's, see tools/avrrc.c
+#define PB0_LOW 115
+#define PB0_HIGH 140
+#define PIN_POLL_US 2000
+
+// brightest channel a run may start on with -d
+#define DARK_MAX 16
+
+volatile uint8_t PORTB, DDRB, PUEB, CCP, CLKPSR, WDTCSR, SMCR, PRR, ACSR;
+volatile uint8_t ADCSRA, ADCSRB, ADMUX, ADCL, DIDR0, PCMSK, PCICR, PCIFR;
+
+extern uint32_t millis;
+int throwie_main(void);
+
+static light_t light;
+static uint64_t now_us, end_us;
+static FILE *csv;
+static unsigned long frames, wakeups;
+static int pb0;       // PB0 digital input, with the Schmitt trigger's memory
+static int converted; // the last sleep was an ADC conversion
+static int check_dark;
+static uint64_t frame_us; // when the last frame was shown
+static int was_off = 1;   // and whether it was all off
+
+static uint8_t level(void)
+{
+    double l = light_at(&light, now_us / 1e6);
+    return l < 0 ? 0 : l > 255 ? 255 : (uint8_t)(l + 0.5);
+}
+
+// PB0 only sees the light level while PB1 drives the divider
+static uint8_t pb0_level(void)
+{
+    return (PORTB & DDRB & (1 << PORTB1)) ? level() : 0;
+}
+
+static int pb0_digital(void)
+{
+    uint8_t l = pb0_level();
+
+    if (DIDR0 & (1 << ADC0D))
+        return 0;
+    if (l >= PB0_HIGH)
+        pb0 = 1;
+    else if (l <= PB0_LOW)
+        pb0 = 0;
+    return pb0;
+}
+
+uint8_t host_pinb(void)
+{
+    return (PORTB & DDRB) | pb0_digital();
+}
+
+static void finish(void)
+{
+    fflush(csv);
+    fprintf(stderr, "%.2f h virtual, %lu frames, %lu wakeups, millis %.2f h\n", now_us / 3.6e9, frames,
+            wakeups, millis / 3.6e6);
+    exit(0);
+}
+
+static void fail(const char *why)
+{
+    fprintf(stderr, "at %.3f s: %s\n", now_us / 1e6, why);
+    exit(1);
+}
+
+static uint64_t adc_us(void)
+{
+    static const uint8_t prescale[8] = {2, 2, 4, 8, 16, 32, 64, 128};
+    unsigned clocks = converted ? 13 : 25;
+
+    // ADC clocks of prescale CPU clocks of 1 << CLKPSR 8 MHz periods
+    return (uint64_t)clocks * prescale[ADCSRA & 7] * (1u << (CLKPSR & 0x0f)) / 8;
+}
+
+void host_sleep(void)
+{
+    uint8_t mode = SMCR >> 1 & 7;
+    int watchdog = WDTCSR & (1 << WDIE | 1 << WDE);
+    uint64_t period = 16000ull << ((WDTCSR & 7) | (WDTCSR >> WDP3 & 1) << 3);
+
+    if (!(SMCR & (1 << SE)))
+        return;
+
+    if (mode == 1) // ADC noise reduction
+    {
+        if (!(ADCSRA & (1 << ADEN)))
+            fail("ADC noise reduction sleep with the ADC off");
+        if (PRR & (1 << PRADC))
+            fail("ADC conversion with PRADC set");
+        now_us += adc_us();
+        ADCL = pb0_level();
+        converted = 1;
+    }
+    else if (mode == 2) // power down
+    {
+        converted = 0;
+        if ((PCICR & (1 << PCIE0)) && (PCMSK & (1 << PCINT0)))
+        {
+            int was = pb0_digital();
+            uint64_t until = watchdog ? now_us + period : end_us;
+
+            while (now_us < until && pb0_digital() == was)
+                now_us += PIN_POLL_US;
+        }
+        else if (watchdog)
+            now_us += period;
+        else
+            fail("asleep with nothing enabled to wake up");
+    }
+    else
+        fail("sleep mode the virtual device doesn't know");
+
+    wakeups++;
+    if (now_us >= end_us)
+        finish();
+}
+
+// printf is most of the run time for a night of BREATHE, so frames are
+// formatted by hand
+static char *put_uint(char *p, unsigned long v, int digits)
+{
+    char tmp[20];
+    int n = 0;
+
+    do
+    {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v || n < digits);
+    while (n)
+        *p++ = tmp[--n];
+    return p;
+}
+
+void host_frame(const uint8_t *color, uint8_t size)
+{
+    char line[32 + 4 * 3 * 8], *p = line;
+    int off = 1, dark = 1;
+
+    for (int i = 0; i < size; i++)
+    {
+        off &= !color[i];
+        dark &= color[i] <= DARK_MAX;
+    }
+    if (check_dark && was_off && !dark && (!frames || now_us - frame_us > 1000000))
+        fail("a run starts lit, the first frame after dark isn't");
+    was_off = off;
+    frame_us = now_us;
+
+    if (!frames)
+    {
+        fprintf(csv, "ms,millis");
+        for (int i = 0; i < size / 3; i++)
+            fprintf(csv, ",g%d,r%d,b%d", i, i, i);
+        fprintf(csv, "\n");
+    }
+    frames++;
+
+    p = put_uint(p, now_us / 1000, 1);
+    *p++ = '.';
+    p = put_uint(p, now_us % 1000, 3);
+    *p++ = ',';
+    p = put_uint(p, millis, 1);
+    for (int i = 0; i < size; i++)
+    {
+        *p++ = ',';
+        p = put_uint(p, color[i], 1);
+    }
+    *p++ = '\n';
+    fwrite(line, 1, p - line, csv);
+}
+
+static double parse_time(const char *s)
+{
+    char *end;
+    double t = strtod(s, &end);
+    if (*end == 'h')
+        t *= 3600;
+    else if (*end == 'm')
+        t *= 60;
+    return t;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: throwie2-host [-t time] [-l level | -L trace] [-o frames.csv] [-d]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 0;
+    const char *trace = NULL, *out = NULL;
+    int opt;
+
+    light_constant(&light, 200);
+
+    while ((opt = getopt(argc, argv, "t:l:L:o:d")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            seconds = parse_time(optarg);
+            break;
+        case 'l':
+            light_free(&light);
+            light_constant(&light, atof(optarg));
+            break;
+        case 'L':
+            trace = optarg;
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        case 'd':
+            check_dark = 1;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc)
+        usage();
+
+    if (trace)
+    {
+        light_free(&light);
+        if (light_load(&light, trace))
+            return 1;
+    }
+    if (!seconds)
+        seconds = light_end(&light) ? light_end(&light) : 12 * 3600;
+    end_us = (uint64_t)(seconds * 1e6);
+
+    csv = stdout;
+    if (out && !(csv = fopen(out, "w")))
+    {
+        perror(out);
+        return 1;
+    }
+
+    throwie_main();
+    return 0;
+}
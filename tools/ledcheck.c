@@ -0,0 +1,292 @@
+/*
+Run a throwie2 image, record every edge on the SK6803 data pin (PB2) and
+check each bit against the datasheet windows.
+
+    ledcheck [options] avrgcc/throwie2.elf
+
+    -t TIME   simulated time, seconds or with an m/h suffix (default 10)
+    -l LEVEL  constant light level on PB0 (default 200, see avrsim)
+    -L FILE   light trace instead
+    -o FILE   write the PB2 waveform as a VCD file
+    -v        print every bit that was checked
+
+A bit is a high pulse and the low that follows it. The high width decides
+whether it is a 0 or a 1, the low has to match the same code unless it is
+long enough to be a reset, which ends the frame. Widths are measured on
+the emulated clock, so a CLKPSR change is checked along with the asm.
+
+Exits with 1 when any bit or reset is out of spec, no frame was sent or a
+frame isn't a whole number of pixels, and prints the worst margin to a
+window edge in nanoseconds either way.
+*/
+
+#include "avrrc.h"
+#include "light.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define LED_PIN 2
+
+// SK6803 datasheet, +-150 ns on every data width
+#define T0H_NS 300
+#define T1H_NS 600
+#define T0L_NS 900
+#define T1L_NS 600
+#define TOL_NS 150
+#define RESET_NS 80000
+
+typedef struct
+{
+    const char *name;
+    long min, max;
+} window_t;
+
+static const window_t t0h = {"T0H", T0H_NS - TOL_NS, T0H_NS + TOL_NS};
+static const window_t t1h = {"T1H", T1H_NS - TOL_NS, T1H_NS + TOL_NS};
+static const window_t t0l = {"T0L", T0L_NS - TOL_NS, T0L_NS + TOL_NS};
+static const window_t t1l = {"T1L", T1L_NS - TOL_NS, T1L_NS + TOL_NS};
+
+typedef struct
+{
+    FILE *vcd;
+    int verbose;
+    uint64_t rise, fall; // ticks of the last edges
+    int have_rise;
+    int code; // code of the pending bit, -1 if its high was out of spec
+
+    unsigned long bits, frame_bits, frames, errors;
+    long worst; // smallest margin seen, ns
+    const char *worst_what;
+    long worst_width;
+} check_t;
+
+static long ns(uint64_t ticks)
+{
+    return (long)(ticks * AVR_TICK_NS);
+}
+
+static void error(check_t *c, uint64_t at, const char *fmt, long width)
+{
+    c->errors++;
+    if (c->errors <= 20)
+    {
+        printf("  %.3f us, frame %lu bit %lu: ", avr_seconds(at) * 1e6, c->frames, c->frame_bits);
+        printf(fmt, width);
+        printf("\n");
+    }
+}
+
+static void margin(check_t *c, const window_t *w, long width)
+{
+    long m = width - w->min < w->max - width ? width - w->min : w->max - width;
+    if (!c->worst_what || m < c->worst)
+    {
+        c->worst = m;
+        c->worst_what = w->name;
+        c->worst_width = width;
+    }
+}
+
+static int within(const window_t *w, long width)
+{
+    return width >= w->min && width <= w->max;
+}
+
+static void end_frame(check_t *c, uint64_t at)
+{
+    if (c->frame_bits % 24)
+        error(c, at, "frame of %ld bits is not a whole number of pixels", (long)c->frame_bits);
+    c->frames++;
+    c->frame_bits = 0;
+}
+
+static void high(check_t *c, uint64_t at, long width)
+{
+    if (within(&t0h, width))
+    {
+        c->code = 0;
+        margin(c, &t0h, width);
+    }
+    else if (within(&t1h, width))
+    {
+        c->code = 1;
+        margin(c, &t1h, width);
+    }
+    else
+    {
+        c->code = -1;
+        error(c, at, "high of %ld ns is neither T0H nor T1H", width);
+    }
+}
+
+static void low(check_t *c, uint64_t at, long width)
+{
+    const window_t *w = c->code ? &t1l : &t0l;
+
+    if (c->verbose)
+        printf("  %.3f us  bit %c  high %ld ns  low %ld ns\n", avr_seconds(c->rise) * 1e6,
+               c->code < 0 ? '?' : '0' + c->code, ns(c->fall - c->rise), width);
+
+    if (width < RESET_NS && c->code >= 0)
+    {
+        if (within(w, width))
+            margin(c, w, width);
+        else
+            error(c, at, c->code ? "low of %ld ns after a 1 is outside T1L" : "low of %ld ns after a 0 is outside T0L",
+                  width);
+    }
+
+    c->bits++;
+    c->frame_bits++;
+    if (width >= RESET_NS)
+        end_frame(c, at);
+}
+
+static void on_portb(void *ctx, avr_t *avr, uint8_t old, uint8_t now)
+{
+    check_t *c = ctx;
+    int level = now >> LED_PIN & 1;
+
+    if (level == (old >> LED_PIN & 1))
+        return;
+
+    if (c->vcd)
+        fprintf(c->vcd, "#%llu\n%d!\n", (unsigned long long)avr->ticks * AVR_TICK_NS, level);
+
+    if (level)
+    {
+        // the low before this rise, unless it was the line idling
+        if (c->have_rise)
+            low(c, avr->ticks, ns(avr->ticks - c->fall));
+        c->rise = avr->ticks;
+        c->have_rise = 1;
+    }
+    else if (c->have_rise)
+    {
+        c->fall = avr->ticks;
+        high(c, avr->ticks, ns(c->fall - c->rise));
+    }
+}
+
+static double parse_time(const char *s)
+{
+    char *end;
+    double t = strtod(s, &end);
+    if (*end == 'h')
+        t *= 3600;
+    else if (*end == 'm')
+        t *= 60;
+    return t;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: ledcheck [-t time] [-l level | -L trace] [-o out.vcd] [-v] firmware.elf|.hex\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    static avr_t avr;
+    light_t light = {0};
+    check_t c = {0};
+    double seconds = 10;
+    const char *trace = NULL, *vcd = NULL;
+    int opt;
+
+    light_constant(&light, 200);
+
+    while ((opt = getopt(argc, argv, "t:l:L:o:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            seconds = parse_time(optarg);
+            break;
+        case 'l':
+            light_free(&light);
+            light_constant(&light, atof(optarg));
+            break;
+        case 'L':
+            trace = optarg;
+            break;
+        case 'o':
+            vcd = optarg;
+            break;
+        case 'v':
+            c.verbose = 1;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind + 1 != argc)
+        usage();
+
+    if (trace)
+    {
+        light_free(&light);
+        if (light_load(&light, trace))
+            return 1;
+    }
+
+    avr_init(&avr);
+    if (avr_load(&avr, argv[optind], NULL))
+        return 1;
+
+    if (vcd)
+    {
+        c.vcd = fopen(vcd, "w");
+        if (!c.vcd)
+        {
+            perror(vcd);
+            return 1;
+        }
+        fprintf(c.vcd, "$timescale 1ns $end\n"
+                       "$scope module throwie2 $end\n"
+                       "$var wire 1 ! PB2 $end\n"
+                       "$upscope $end\n"
+                       "$enddefinitions $end\n"
+                       "#0\n0!\n");
+    }
+
+    avr.light = light_avr;
+    avr.light_ctx = &light;
+    avr.on_portb = on_portb;
+    avr.portb_ctx = &c;
+
+    avr_run_until(&avr, (uint64_t)(seconds * AVR_OSC_HZ));
+
+    // the line has been low since the last fall, that's the last reset
+    if (c.have_rise && avr.ticks > c.fall && !(avr.io[AVR_PORTB] >> LED_PIN & 1))
+        low(&c, avr.ticks, ns(avr.ticks - c.fall));
+
+    if (c.vcd)
+    {
+        fprintf(c.vcd, "#%llu\n", (unsigned long long)avr.ticks * AVR_TICK_NS);
+        fclose(c.vcd);
+    }
+
+    if (avr.error[0])
+    {
+        fprintf(stderr, "%s: stopped: %s\n", argv[optind], avr.error);
+        c.errors++;
+    }
+    if (!c.frames)
+    {
+        printf("  no frame sent in %.1f s\n", seconds);
+        c.errors++;
+    }
+
+    printf("%s: %lu frames, %lu bits in %.1f s, ", argv[optind], c.frames, c.bits, seconds);
+    if (c.worst_what)
+        printf("worst margin %ld ns (%s %ld ns)", c.worst, c.worst_what, c.worst_width);
+    else
+        printf("no bit in spec");
+    printf(", %lu errors\n", c.errors);
+
+    light_free(&light);
+    return c.errors ? 1 : 0;
+}
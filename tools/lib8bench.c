@@ -0,0 +1,544 @@
+/*
+lib8tion accuracy and cost on the reduced core.
+
+    lib8bench [-b avrgcc/lib8-none.elf avrgcc/lib8-*.elf]
+
+Runs every function in the table below over its whole input space, every
+8-bit or 8x8 combination, all 65536 values for a 16-bit argument and
+every 16x8 or 8x8x8 combination, against a double precision reference,
+and prints the largest and mean error in output steps (LSB), where the
+largest one is, and the largest as a share of full scale, which is what
+lib8tion's "never varies more than 2%" claims mean.
+
+This file is built for the host with LIB8_MULFREE=1, which is the code
+the ATtiny5 runs (the asm mul8by8 gives the same results as the C one,
+see lib8tion.h).
+
+With -b and images built from lib8bench_avr.c (./build.sh lib8 does
+both), each image is run on the AVRrc model and the table gets the
+cycles per call, min/avg/max over the image's inputs, and the flash the
+function adds. Both are relative to the -b image, which calls a function
+that only returns its argument, so they are what a call costs beyond the
+RCALL, RET and argument moves. Images are matched to rows by name,
+avrgcc/lib8-NAME.elf.
+
+The curve rows are curve16() on tools/curves' tables (curve.h), built
+with -Iavrgcc for avrgcc/curves.h, next to the lib8tion curves they can
+stand in for. The colour rows check the red channel against the exact
+rainbow and palette blend.
+*/
+
+#include "avrrc.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../lib8tion/lib8tion.h"
+
+#define PROGMEM // the host reads the tables like the reduced core does
+#include "../curve.h"
+#include "../palette.h"
+#include "curves.h"
+
+#define ease_curve(x) curve16(ease_table, x, EASE_TABLE_BITS)
+#define breath_curve(x) curve16(breath_table, x, BREATH_TABLE_BITS)
+#define gamma_curve(x) curve16(gamma_table, x, GAMMA_TABLE_BITS)
+
+// lib8tion's colour functions as rows: hsv_rainbow is hsv2rgb_rainbow()
+// with a, b, c as hue, sat and val, palette16 color_from_palette16() on
+// party_palette, and both give their red channel here (the images xor
+// all three, so none is left out of the cycles)
+
+static uint8_t hsv_rainbow(uint8_t hue, uint8_t sat, uint8_t val)
+{
+    uint8_t r, g, b;
+    hsv2rgb_rainbow(hue, sat, val, &r, &g, &b);
+    return r;
+}
+
+static uint8_t palette16(uint8_t index)
+{
+    uint8_t r, g, b;
+    color_from_palette16(party_palette, index, &r, &g, &b);
+    return r;
+}
+
+enum kind
+{
+    U8,    // uint8_t f(uint8_t)
+    U88,   // uint8_t f(uint8_t, uint8_t)
+    U888,  // uint8_t f(uint8_t, uint8_t, uint8_t)
+    U16,   // uint16_t f(uint16_t)
+    U16_8, // uint16_t f(uint16_t, uint8_t)
+    U8_16, // uint8_t f(uint16_t)
+};
+
+typedef struct
+{
+    const char *name;
+    enum kind kind;
+    double (*actual)(unsigned a, unsigned b, unsigned c);
+    double (*ref)(unsigned a, unsigned b, unsigned c);
+    double full; // full scale of the result
+} check_t;
+
+typedef struct
+{
+    double max, mean;
+    unsigned long at[3]; // inputs of the largest error
+    unsigned long count;
+} error_t;
+
+typedef struct
+{
+    int have;
+    double min, avg, max; // cycles per call, less the baseline's
+    long bytes;           // flash, less the baseline's
+} cost_t;
+
+static double clamp(double v, double lo, double hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+// the easing curves lib8tion approximates, t in 0..1
+static double quad(double t)
+{
+    return t < 0.5 ? 2 * t * t : 1 - 2 * (1 - t) * (1 - t);
+}
+
+static double cubic(double t)
+{
+    return t * t * (3 - 2 * t);
+}
+
+// the rising half of the exp(sin) breath, as tools/curves samples it
+static double breath(double t)
+{
+    return (exp(sin(M_PI * (t - 0.5))) - exp(-1)) / (exp(1) - exp(-1));
+}
+
+// red of the rainbow hue wheel, 8 sections of 32 with exact thirds, then
+// saturation and value as hsv2rgb_rainbow() applies them
+static double rainbow_red(unsigned hue, unsigned sat, unsigned val)
+{
+    static const double from[8] = {255, 171, 171, 0, 0, 0, 85, 170};
+    static const double third[8] = {-1, 0, -2, 0, 0, 1, 1, 1};
+    double r = from[hue >> 5] + third[hue >> 5] * 256 / 3 * (hue & 31) / 32;
+
+    if (sat != 255)
+    {
+        double desat = (255.0 - sat) * (255 - sat) / 256;
+        r = r * (255 - desat) / 256 + desat;
+    }
+    if (val != 255)
+        r = r * (val * val / 256.0) / 256;
+    return r;
+}
+
+// red of party_palette between entries
+static double palette_red(unsigned index)
+{
+    double from = party_palette[(index >> 4) * 3];
+    double to = party_palette[((index >> 4) + 1) % 16 * 3];
+    return from + (to - from) * (index & 15) / 16;
+}
+
+// noise8()'s lattice points eased by the exact cubic
+static double lattice(unsigned x)
+{
+    double from = noise8_hash(x >> 8), to = noise8_hash((x >> 8) + 1);
+    return from + (to - from) * cubic((x & 255) / 256.0);
+}
+
+// triangle wave of an 8-bit phase, 0..1..0
+static double tri(unsigned a)
+{
+    double x = a / 256.0;
+    return x < 0.5 ? 2 * x : 2 - 2 * x;
+}
+
+#define ACTUAL(name, expr)                                        \
+    static double actual_##name(unsigned a, unsigned b, unsigned c) \
+    {                                                             \
+        (void)a, (void)b, (void)c;                                \
+        return (expr);                                            \
+    }
+#define REF(name, expr)                                        \
+    static double ref_##name(unsigned a, unsigned b, unsigned c) \
+    {                                                          \
+        (void)a, (void)b, (void)c;                             \
+        return (expr);                                         \
+    }
+
+// math8
+ACTUAL(qadd8, qadd8(a, b))
+REF(qadd8, clamp(a + b, 0, 255))
+ACTUAL(qsub8, qsub8(a, b))
+REF(qsub8, clamp((double)a - b, 0, 255))
+ACTUAL(avg8, avg8(a, b))
+REF(avg8, (a + b) / 2.0)
+ACTUAL(mul8, mul8(a, b))
+REF(mul8, (a * b) & 0xFF)
+ACTUAL(qmul8, qmul8(a, b))
+REF(qmul8, clamp(a * b, 0, 255))
+ACTUAL(sqrt16, sqrt16(a))
+REF(sqrt16, sqrt(a))
+ACTUAL(blend8, blend8(a, b, c))
+REF(blend8, a + ((double)b - a) * c / 256)
+ACTUAL(lerp8by8, lerp8by8(a, b, c))
+REF(lerp8by8, a + ((double)b - a) * c / 256)
+
+// scale8
+ACTUAL(scale8, scale8(a, b))
+REF(scale8, a * b / 256.0)
+ACTUAL(scale8_video, scale8_video(a, b))
+REF(scale8_video, a * b / 256.0)
+ACTUAL(scale16by8, scale16by8(a, b))
+REF(scale16by8, a * b / 256.0)
+ACTUAL(dim8_raw, dim8_raw(a))
+REF(dim8_raw, a * a / 256.0)
+ACTUAL(dim8_video, dim8_video(a))
+REF(dim8_video, a * a / 256.0)
+
+// trig8, against the formulas their comments give
+ACTUAL(sin8, sin8(a))
+REF(sin8, clamp(sin(a * M_PI / 128) * 128 + 128, 0, 255))
+ACTUAL(cos8, cos8(a))
+REF(cos8, clamp(cos(a * M_PI / 128) * 128 + 128, 0, 255))
+ACTUAL(sin16, sin16(a))
+REF(sin16, sin(a * M_PI / 32768) * 32767)
+ACTUAL(cos16, cos16(a))
+REF(cos16, cos(a * M_PI / 32768) * 32767)
+
+// easing and waves
+ACTUAL(ease8InOutQuad, ease8InOutQuad(a))
+REF(ease8InOutQuad, 255 * quad(a / 255.0))
+ACTUAL(ease8InOutCubic, ease8InOutCubic(a))
+REF(ease8InOutCubic, 255 * cubic(a / 255.0))
+ACTUAL(ease8InOutApprox, ease8InOutApprox(a))
+REF(ease8InOutApprox, 255 * cubic(a / 255.0))
+ACTUAL(ease16InOutQuad, ease16InOutQuad(a))
+REF(ease16InOutQuad, 65535 * quad(a / 65535.0))
+ACTUAL(ease16InOutApprox, ease16InOutApprox(a))
+REF(ease16InOutApprox, 65535 * cubic(a / 65535.0))
+ACTUAL(triwave8, triwave8(a))
+REF(triwave8, 255 * tri(a))
+ACTUAL(quadwave8, quadwave8(a))
+REF(quadwave8, 255 * quad(tri(a)))
+ACTUAL(cubicwave8, cubicwave8(a))
+REF(cubicwave8, 255 * cubic(tri(a)))
+
+// curve.h
+ACTUAL(ease_curve, ease_curve(a))
+REF(ease_curve, 65535 * cubic(a / 65535.0))
+ACTUAL(breath_curve, breath_curve(a))
+REF(breath_curve, 65535 * breath(a / 65535.0))
+ACTUAL(gamma_curve, gamma_curve(a))
+REF(gamma_curve, 65535 * pow(a / 65535.0, GAMMA_TABLE_EXP))
+
+// noise8.h
+ACTUAL(noise8, noise8(a))
+REF(noise8, lattice(a))
+
+// color8.h
+ACTUAL(hsv_rainbow, hsv_rainbow(a, b, c))
+REF(hsv_rainbow, rainbow_red(a, b, c))
+ACTUAL(palette16, palette16(a))
+REF(palette16, palette_red(a))
+
+#define CHECK(name, kind, full) {#name, kind, actual_##name, ref_##name, full}
+
+static const check_t checks[] = {
+    CHECK(qadd8, U88, 255),
+    CHECK(qsub8, U88, 255),
+    CHECK(avg8, U88, 255),
+    CHECK(mul8, U88, 255),
+    CHECK(qmul8, U88, 255),
+    CHECK(sqrt16, U8_16, 255),
+    CHECK(blend8, U888, 255),
+    CHECK(lerp8by8, U888, 255),
+    CHECK(scale8, U88, 255),
+    CHECK(scale8_video, U88, 255),
+    CHECK(scale16by8, U16_8, 65535),
+    CHECK(dim8_raw, U8, 255),
+    CHECK(dim8_video, U8, 255),
+    CHECK(sin8, U8, 255),
+    CHECK(cos8, U8, 255),
+    CHECK(sin16, U16, 65534),
+    CHECK(cos16, U16, 65534),
+    CHECK(ease8InOutQuad, U8, 255),
+    CHECK(ease8InOutCubic, U8, 255),
+    CHECK(ease8InOutApprox, U8, 255),
+    CHECK(ease16InOutQuad, U16, 65535),
+    CHECK(ease16InOutApprox, U16, 65535),
+    CHECK(triwave8, U8, 255),
+    CHECK(quadwave8, U8, 255),
+    CHECK(cubicwave8, U8, 255),
+    CHECK(ease_curve, U16, 65535),
+    CHECK(breath_curve, U16, 65535),
+    CHECK(gamma_curve, U16, 65535),
+    CHECK(noise8, U8_16, 255),
+    CHECK(hsv_rainbow, U888, 255),
+    CHECK(palette16, U8, 255),
+};
+
+#define CHECKS (sizeof(checks) / sizeof(checks[0]))
+
+static void sample(const check_t *ch, error_t *e, unsigned a, unsigned b, unsigned c)
+{
+    double err = fabs(ch->actual(a, b, c) - ch->ref(a, b, c));
+
+    e->mean += err;
+    e->count++;
+    if (err > e->max || e->count == 1)
+    {
+        e->max = err;
+        e->at[0] = a;
+        e->at[1] = b;
+        e->at[2] = c;
+    }
+}
+
+static void measure(const check_t *ch, error_t *e)
+{
+    memset(e, 0, sizeof(*e));
+
+    switch (ch->kind)
+    {
+    case U8:
+        for (unsigned a = 0; a < 256; a++)
+            sample(ch, e, a, 0, 0);
+        break;
+    case U88:
+        for (unsigned a = 0; a < 256; a++)
+            for (unsigned b = 0; b < 256; b++)
+                sample(ch, e, a, b, 0);
+        break;
+    case U888:
+        for (unsigned a = 0; a < 256; a++)
+            for (unsigned b = 0; b < 256; b++)
+                for (unsigned c = 0; c < 256; c++)
+                    sample(ch, e, a, b, c);
+        break;
+    case U16:
+    case U8_16:
+        for (unsigned a = 0; a < 65536; a++)
+            sample(ch, e, a, 0, 0);
+        break;
+    case U16_8:
+        for (unsigned a = 0; a < 65536; a++)
+            for (unsigned b = 0; b < 256; b++)
+                sample(ch, e, a, b, 0);
+        break;
+    }
+    e->mean /= e->count;
+}
+
+static void print_at(const check_t *ch, const error_t *e)
+{
+    char at[32];
+
+    switch (ch->kind)
+    {
+    case U8:
+    case U16:
+    case U8_16:
+        snprintf(at, sizeof(at), "(%lu)", e->at[0]);
+        break;
+    case U88:
+    case U16_8:
+        snprintf(at, sizeof(at), "(%lu,%lu)", e->at[0], e->at[1]);
+        break;
+    case U888:
+        snprintf(at, sizeof(at), "(%lu,%lu,%lu)", e->at[0], e->at[1], e->at[2]);
+        break;
+    }
+    printf("%-16s", e->max ? at : "");
+}
+
+/*
+Cycles on the AVRrc model
+*/
+
+typedef struct
+{
+    uint16_t entry; // word address of bench()
+    int active;
+    uint16_t sp;
+    uint64_t start;
+    uint64_t calls, min, max, total;
+} calls_t;
+
+static void on_call(void *ctx, avr_t *avr, uint16_t target, uint16_t sp)
+{
+    calls_t *t = ctx;
+
+    if (target != t->entry || t->active)
+        return;
+    t->active = 1;
+    t->sp = sp + 2; // SP once the return address is popped
+    t->start = avr->cycles;
+}
+
+static void on_ret(void *ctx, avr_t *avr, uint16_t sp)
+{
+    calls_t *t = ctx;
+
+    if (!t->active || sp != t->sp)
+        return;
+    t->active = 0;
+
+    uint64_t cycles = avr->cycles - t->start;
+    if (!t->calls || cycles < t->min)
+        t->min = cycles;
+    if (cycles > t->max)
+        t->max = cycles;
+    t->total += cycles;
+    t->calls++;
+}
+
+// Run an image to its BREAK, returns 0 and its flash size and cycles per
+// call of bench()
+static int time_image(const char *path, long *bytes, calls_t *t)
+{
+    static avr_t avr;
+    avr_syms_t syms = {0};
+
+    avr_init(&avr);
+    if (avr_load(&avr, path, &syms))
+        return -1;
+
+    const avr_sym_t *sym = avr_sym_find(&syms, "bench");
+    if (!sym || !sym->func)
+    {
+        fprintf(stderr, "%s: no bench() function\n", path);
+        avr_syms_free(&syms);
+        return -1;
+    }
+
+    memset(t, 0, sizeof(*t));
+    t->entry = sym->addr / 2;
+    avr.on_call = on_call;
+    avr.on_ret = on_ret;
+    avr.call_ctx = t;
+
+    // a few million cycles at most, stop runaways after 10 s
+    avr_run_until(&avr, 10ull * AVR_OSC_HZ);
+    avr_syms_free(&syms);
+
+    // BREAK stops the model without an error
+    if (!avr.stopped || avr.error[0])
+    {
+        fprintf(stderr, "%s: didn't reach its BREAK%s%s\n", path, avr.error[0] ? ": " : "", avr.error);
+        return -1;
+    }
+    if (!t->calls)
+    {
+        fprintf(stderr, "%s: bench() never returned\n", path);
+        return -1;
+    }
+    *bytes = avr.flash_size;
+    return 0;
+}
+
+static const char *image_name(const char *path, char *name, size_t size)
+{
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    if (!strncmp(base, "lib8-", 5))
+        base += 5;
+    snprintf(name, size, "%s", base);
+    char *dot = strrchr(name, '.');
+    if (dot)
+        *dot = '\0';
+    return name;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: lib8bench [-b baseline.elf image.elf...]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    static cost_t costs[CHECKS];
+    const char *baseline = NULL;
+    int opt, failed = 0;
+
+    while ((opt = getopt(argc, argv, "b:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            baseline = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (!baseline && optind != argc)
+        usage();
+
+    if (baseline)
+    {
+        calls_t base, t;
+        long base_bytes, bytes;
+
+        if (time_image(baseline, &base_bytes, &base))
+            return 1;
+
+        for (int i = optind; i < argc; i++)
+        {
+            char name[64];
+            size_t c;
+
+            image_name(argv[i], name, sizeof(name));
+            if (!strcmp(argv[i], baseline))
+                continue;
+            for (c = 0; c < CHECKS && strcmp(checks[c].name, name); c++)
+                ;
+            if (c == CHECKS)
+            {
+                fprintf(stderr, "%s: no function %s in the table\n", argv[i], name);
+                failed = 1;
+                continue;
+            }
+            if (time_image(argv[i], &bytes, &t))
+            {
+                failed = 1;
+                continue;
+            }
+            costs[c].have = 1;
+            costs[c].min = (double)t.min - base.min;
+            costs[c].max = (double)t.max - base.max;
+            costs[c].avg = (double)t.total / t.calls - (double)base.total / base.calls;
+            costs[c].bytes = bytes - base_bytes;
+        }
+    }
+
+    printf("%-18s %9s  %-16s %9s %7s", "function", "max LSB", "at", "mean LSB", "max %");
+    if (baseline)
+        printf("  %15s %7s", "cycles min/avg/max", "bytes");
+    printf("\n");
+
+    for (size_t c = 0; c < CHECKS; c++)
+    {
+        const check_t *ch = &checks[c];
+        error_t e;
+
+        measure(ch, &e);
+        printf("%-18s %9.3f  ", ch->name, e.max);
+        print_at(ch, &e);
+        printf(" %9.4f %6.2f%%", e.mean, 100 * e.max / ch->full);
+        if (costs[c].have)
+            printf("  %5.0f/%5.1f/%5.0f %7ld", costs[c].min, costs[c].avg, costs[c].max, costs[c].bytes);
+        printf("\n");
+    }
+
+    return failed;
+}
@@ -0,0 +1,133 @@
+/*
+One lib8tion function on its own, for tools/lib8bench to time on the
+AVRrc model. ./build.sh lib8 builds one image per function as
+
+    avr-gcc -mmcu=attiny5 -Os -DBENCH=sin8 -DKIND=U8 -o avrgcc/lib8-sin8.elf tools/lib8bench_avr.c
+
+and BENCH=none once, which makes the same calls to a function that just
+returns its first argument: its cycles are the call overhead that gets
+taken off, its size the flash every image has anyway.
+
+bench() is kept out of line and away from interprocedural optimisation so
+every call runs the whole function, main() calls it over a spread of
+inputs for the min, average and max, then stops the model with BREAK.
+*/
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "../curve.h"
+#include "../lib8tion/lib8tion.h"
+#include "../palette.h"
+#include "curves.h"
+
+#define ease_curve(x) curve16(ease_table, x, EASE_TABLE_BITS)
+#define breath_curve(x) curve16(breath_table, x, BREATH_TABLE_BITS)
+#define gamma_curve(x) curve16(gamma_table, x, GAMMA_TABLE_BITS)
+
+// the colour functions as rows, see lib8bench.c, with the three channels
+// xored so all of them are worked out
+
+static inline uint8_t hsv_rainbow(uint8_t hue, uint8_t sat, uint8_t val)
+{
+    uint8_t r, g, b;
+    hsv2rgb_rainbow(hue, sat, val, &r, &g, &b);
+    return r ^ g ^ b;
+}
+
+static inline uint8_t palette16(uint8_t index)
+{
+    uint8_t r, g, b;
+    color_from_palette16(party_palette, index, &r, &g, &b);
+    return r ^ g ^ b;
+}
+
+// argument and result types, see lib8bench.c for what each function is
+#define U8 1    // uint8_t f(uint8_t)
+#define U88 2   // uint8_t f(uint8_t, uint8_t)
+#define U888 3  // uint8_t f(uint8_t, uint8_t, uint8_t)
+#define U16 4   // uint16_t f(uint16_t)
+#define U16_8 5 // uint16_t f(uint16_t, uint8_t)
+#define U8_16 6 // uint8_t f(uint16_t)
+
+#define none(a, ...) (a)
+
+#define BENCH_FN __attribute__((noipa))
+
+volatile uint16_t sink;
+
+#if KIND == U8
+
+BENCH_FN uint8_t bench(uint8_t a)
+{
+    return BENCH(a);
+}
+
+#elif KIND == U88
+
+BENCH_FN uint8_t bench(uint8_t a, uint8_t b)
+{
+    return BENCH(a, b);
+}
+
+#elif KIND == U888
+
+BENCH_FN uint8_t bench(uint8_t a, uint8_t b, uint8_t c)
+{
+    return BENCH(a, b, c);
+}
+
+#elif KIND == U16
+
+BENCH_FN uint16_t bench(uint16_t a)
+{
+    return BENCH(a);
+}
+
+#elif KIND == U16_8
+
+BENCH_FN uint16_t bench(uint16_t a, uint8_t b)
+{
+    return BENCH(a, b);
+}
+
+#elif KIND == U8_16
+
+BENCH_FN uint8_t bench(uint16_t a)
+{
+    return BENCH(a);
+}
+
+#else
+#error "KIND must be one of U8, U88, U888, U16, U16_8, U8_16"
+#endif
+
+int main(void)
+{
+    // a takes all 256 values (times 257 for a 16-bit argument), b 16
+    // evenly spread ones, so every image makes 256 or 4096 calls
+    uint8_t a = 0;
+    do
+    {
+#if KIND == U8
+        sink = bench(a);
+#elif KIND == U16 || KIND == U8_16
+        sink = bench(a * 257u);
+#else
+        uint8_t b = 0;
+        for (uint8_t i = 0; i < 16; i++, b += 17)
+        {
+#if KIND == U88
+            sink = bench(a, b);
+#elif KIND == U16_8
+            sink = bench(a * 257u, b);
+#else
+            sink = bench(a, b, a ^ b);
+#endif
+        }
+#endif
+    } while (++a);
+
+    asm volatile("break");
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "light.h"
+#include "avrrc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void add_point(light_t *light, double t, double level)
+{
+    light->t = realloc(light->t, (light->count + 1) * sizeof(double));
+    light->level = realloc(light->level, (light->count + 1) * sizeof(double));
+    light->t[light->count] = t;
+    light->level[light->count] = level;
+    light->count++;
+}
+
+int light_load(light_t *light, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    int n = 0;
+
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+
+    light->t = light->level = NULL;
+    light->count = 0;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        double t, level;
+        char unit = 's';
+        n++;
+
+        if (sscanf(line, " %lf%c %lf", &t, &unit, &level) == 3 && (unit == 'm' || unit == 'h' || unit == 's'))
+            t *= unit == 'h' ? 3600 : unit == 'm' ? 60 : 1;
+        else if (sscanf(line, " %lf %lf", &t, &level) != 2)
+        {
+            const char *p = line;
+            while (*p == ' ' || *p == '\t')
+                p++;
+            if (*p == '#' || *p == '\n' || *p == '\0')
+                continue;
+            fprintf(stderr, "%s:%d: expected \"<time> <level>\"\n", path, n);
+            fclose(f);
+            return -1;
+        }
+
+        if (light->count && t < light->t[light->count - 1])
+        {
+            fprintf(stderr, "%s:%d: time goes backwards\n", path, n);
+            fclose(f);
+            return -1;
+        }
+        add_point(light, t, level);
+    }
+    fclose(f);
+
+    if (!light->count)
+    {
+        fprintf(stderr, "%s: no points\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+void light_constant(light_t *light, double level)
+{
+    light->t = light->level = NULL;
+    light->count = 0;
+    add_point(light, 0, level);
+}
+
+void light_free(light_t *light)
+{
+    free(light->t);
+    free(light->level);
+    light->t = light->level = NULL;
+    light->count = 0;
+}
+
+double light_at(const light_t *light, double seconds)
+{
+    int i = 0;
+
+    if (seconds <= light->t[0])
+        return light->level[0];
+    while (i + 1 < light->count && light->t[i + 1] <= seconds)
+        i++;
+    if (i + 1 == light->count)
+        return light->level[i];
+
+    double span = light->t[i + 1] - light->t[i];
+    return light->level[i] + (light->level[i + 1] - light->level[i]) * (seconds - light->t[i]) / span;
+}
+
+double light_end(const light_t *light)
+{
+    return light->t[light->count - 1];
+}
+
+uint8_t light_avr(void *ctx, uint64_t ticks)
+{
+    double level = light_at(ctx, avr_seconds(ticks));
+    return level < 0 ? 0 : level > 255 ? 255 : (uint8_t)(level + 0.5);
+}
@@ -0,0 +1,41 @@
+#ifndef LIGHT_H
+#define LIGHT_H
+
+/*
+Ambient light profiles for the host tools. A trace is a text file with
+one "<time> <level>" pair per line, time in seconds or with an m/h
+suffix, level being what the ADC reads on PB0 with the divider powered
+(0..255, higher is darker). Levels are interpolated linearly between
+points and held before the first and after the last one. '#' starts a
+comment.
+
+    # dusk to dawn
+    0     40
+    30m   120
+    12h   120
+    12.5h 30
+*/
+
+#include <stdint.h>
+
+typedef struct
+{
+    double *t;
+    double *level;
+    int count;
+} light_t;
+
+// Load a trace file, returns 0 on success and prints the reason otherwise
+int light_load(light_t *light, const char *path);
+// A trace that stays at one level
+void light_constant(light_t *light, double level);
+void light_free(light_t *light);
+
+double light_at(const light_t *light, double seconds);
+// Time of the last point, 0 for a constant level
+double light_end(const light_t *light);
+
+// Adapter for avr_t.light, ctx is a light_t
+uint8_t light_avr(void *ctx, uint64_t ticks);
+
+#endif
@@ -0,0 +1,37 @@
+/*
+Pack a message into the on/off unit stream MORSE plays, at build time.
+
+    morse "MESSAGE" > avrgcc/morse.h
+
+Every Morse unit is one bit (see morsecode.h for the layout), so the
+player only shifts bits out. Anything without a code is an error, so a
+message that doesn't play the way it reads doesn't build.
+*/
+
+#include "morsecode.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+static uint8_t stream[4096];
+
+int main(int argc, char **argv)
+{
+    unsigned bits;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: morse \"MESSAGE\" > morse.h\n");
+        return 2;
+    }
+    if (morse_encode(argv[1], stream, sizeof(stream), &bits))
+        return 1;
+
+    printf("// Generated by tools/morse from \"%s\", don't edit\n\n", argv[1]);
+    printf("#define MORSE_BITS %u\n\n", bits);
+    printf("const uint8_t morse[] PROGMEM = {");
+    for (unsigned i = 0; i < (bits + 7) / 8; i++)
+        printf("%s0x%02x,", i % 12 ? " " : "\n    ", stream[i]);
+    printf("\n};\n");
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "morsecode.h"
+
+#include <ctype.h>
+#include <stdio.h>
+
+typedef struct
+{
+    char c;
+    const char *code;
+} morse_t;
+
+static const morse_t table[] = {
+    {'A', ".-"},     {'B', "-..."},    {'C', "-.-."},    {'D', "-.."},     {'E', "."},
+    {'F', "..-."},   {'G', "--."},     {'H', "...."},    {'I', ".."},      {'J', ".---"},
+    {'K', "-.-"},    {'L', ".-.."},    {'M', "--"},      {'N', "-."},      {'O', "---"},
+    {'P', ".--."},   {'Q', "--.-"},    {'R', ".-."},     {'S', "..."},     {'T', "-"},
+    {'U', "..-"},    {'V', "...-"},    {'W', ".--"},     {'X', "-..-"},    {'Y', "-.--"},
+    {'Z', "--.."},   {'0', "-----"},   {'1', ".----"},   {'2', "..---"},   {'3', "...--"},
+    {'4', "....-"},  {'5', "....."},   {'6', "-...."},   {'7', "--..."},   {'8', "---.."},
+    {'9', "----."},  {'.', ".-.-.-"},  {',', "--..--"},  {'?', "..--.."},  {'\'', ".----."},
+    {'!', "-.-.--"}, {'/', "-..-."},   {'(', "-.--."},   {')', "-.--.-"},  {'&', ".-..."},
+    {':', "---..."}, {';', "-.-.-."},  {'=', "-...-"},   {'+', ".-.-."},   {'-', "-....-"},
+    {'_', "..--.-"}, {'"', ".-..-."},  {'$', "...-..-"}, {'@', ".--.-."},
+};
+
+static const char *lookup(char c)
+{
+    c = toupper((unsigned char)c);
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+        if (table[i].c == c)
+            return table[i].code;
+    return NULL;
+}
+
+// Append units of on to the stream, 0 when it's full
+static int put(uint8_t *stream, unsigned size, unsigned *bits, int on, int units)
+{
+    while (units--)
+    {
+        if (*bits == size * 8)
+            return 0;
+        if (on)
+            stream[*bits / 8] |= 0x80 >> *bits % 8;
+        (*bits)++;
+    }
+    return 1;
+}
+
+int morse_encode(const char *msg, uint8_t *stream, unsigned size, unsigned *bits)
+{
+    int gap = 0; // units of dark owed before the next character
+
+    *bits = 0;
+    for (const char *p = msg; *p; p++)
+    {
+        if (*p == ' ')
+        {
+            if (*bits)
+                gap = 7;
+            continue;
+        }
+
+        const char *code = lookup(*p);
+        if (!code)
+        {
+            fprintf(stderr, "morse: no code for '%c' in \"%s\"\n", *p, msg);
+            return 1;
+        }
+
+        int fits = put(stream, size, bits, 0, gap);
+        for (const char *e = code; *e; e++)
+        {
+            if (e != code)
+                fits &= put(stream, size, bits, 0, 1);
+            fits &= put(stream, size, bits, 1, *e == '-' ? 3 : 1);
+        }
+        if (!fits)
+        {
+            fprintf(stderr, "morse: \"%s\" is longer than %u units\n", msg, size * 8);
+            return 1;
+        }
+        gap = 3;
+    }
+
+    if (!*bits)
+    {
+        fprintf(stderr, "morse: nothing to send\n");
+        return 1;
+    }
+    return 0;
+}
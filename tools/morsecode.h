@@ -0,0 +1,20 @@
+#ifndef MORSECODE_H
+#define MORSECODE_H
+
+/*
+A message as the Morse unit stream MORSE and the pattern VM's morse op
+play, one bit per unit, MSB first, 1 for lit and 0 for dark: a dit is 1,
+a dah 111, with 0 between the elements of a character, 000 between
+characters and 0000000 between words. Letters are case-insensitive.
+Digits, the ITU punctuation and spaces are supported too.
+*/
+
+#include <stdint.h>
+
+// Pack msg into stream (size bytes, zeroed by the caller) and set *bits
+// to the units used. Returns 0 on success and prints the reason
+// otherwise: a character without a code, a message that doesn't fit or
+// one with nothing to send.
+int morse_encode(const char *msg, uint8_t *stream, unsigned size, unsigned *bits);
+
+#endif
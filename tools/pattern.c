@@ -0,0 +1,391 @@
+/*
+Assemble text patterns into the bytecode the PATTERN effect plays, see
+pattern.h for the ops.
+
+    pattern tools/patterns/breathe.pat [more.pat ...] > avrgcc/bytecode.h
+
+With more than one file the image holds them all, and covering the
+photoresistor steps through them in the order given (see light_task() in
+main.c).
+
+One op per line, '#' starts a comment. Times are in ms and have to be
+whole PT_TICK_MS periods, ramps take a power of two from 2 to 256 frames,
+colours are given red, green, blue (the SK6803 order is handled here).
+
+    color R G B            random                 level V
+    fade FRAMES MS R G B   ramp FRAMES MS V       wait MS
+    loop COUNT ... next    chance P/Q             morse UNIT "TEXT"
+    dark
+
+chance applies to the op after it, which runs with probability P/Q.
+Loops are unrolled here, the ops up to next are repeated COUNT times, so
+a loop costs flash for every time round but the interpreter no SRAM for
+a loop count. morse is split into as many MORSE ops as the message
+needs. The bytes are listed next to the line they came from, and what
+each pattern and the table of where they start cost goes to stderr, so
+the flash an effect costs is in the build log. A pattern that would
+never sleep doesn't assemble.
+*/
+
+#include "morsecode.h"
+#include "../pattern.h"
+#include "../pt.h"
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *path;
+static int line_no;
+
+static uint8_t code[PAT_MAX];
+static int size;
+
+// Most patterns in one image
+#define FILES_MAX 16
+
+static int starts[FILES_MAX + 1];
+
+// where each source line's bytes start, for the listing
+static struct
+{
+    int start, end;
+    int file; // text is the file name the lines after it are from
+    char text[128];
+} lines[PAT_MAX + FILES_MAX];
+static int line_count;
+
+static void fail(const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "%s:%d: ", path, line_no);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+static void emit(int byte)
+{
+    if (size == PAT_MAX)
+        fail("patterns longer than %d bytes together", PAT_MAX);
+    code[size++] = byte;
+}
+
+// next entry in lines
+static int listed(void)
+{
+    if (line_count == sizeof(lines) / sizeof(lines[0]))
+        fail("more ops and files than the listing holds, %d", (int)(sizeof(lines) / sizeof(lines[0])));
+    return line_count++;
+}
+
+static long number(const char *s, long min, long max, const char *what)
+{
+    char *end;
+    long v;
+
+    if (!s)
+        fail("missing %s", what);
+    v = strtol(s, &end, 0);
+    if (*end || end == s || v < min || v > max)
+        fail("%s must be %ld to %ld, not '%s'", what, min, max, s);
+    return v;
+}
+
+static int ticks(const char *s, long max)
+{
+    long ms = number(s, 0, max * PT_TICK_MS, "time in ms");
+
+    if (ms % PT_TICK_MS)
+        fail("%ld ms isn't a multiple of %d ms", ms, PT_TICK_MS);
+    return ms / PT_TICK_MS;
+}
+
+// frames of a ramp as n, frames = 1 << n
+static int frames(const char *s)
+{
+    long f = number(s, 2, 1 << PAT_RAMP_MAX, "frames");
+    int n = 0;
+
+    while ((1L << n) < f)
+        n++;
+    if ((1L << n) != f)
+        fail("frames must be a power of two, not %ld", f);
+    return n;
+}
+
+static void color(char **arg)
+{
+    int r = number(arg[0], 0, 255, "red");
+    int g = number(arg[1], 0, 255, "green");
+    int b = number(arg[2], 0, 255, "blue");
+
+    emit(g);
+    emit(r);
+    emit(b);
+}
+
+// Append the pattern in path to code
+static void assemble(void)
+{
+    FILE *f;
+    char buf[512];
+    int loop = -1;     // first byte of the open loop's body
+    int loop_count = 0;
+    int chance = -1;   // CHANCE whose skip the next op sets
+    int sleeps = 0;    // an op that always takes time
+    int l;             // this line's entry in lines
+
+    f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        exit(1);
+    }
+    line_no = 0;
+
+    l = listed();
+    lines[l].start = lines[l].end = size;
+    lines[l].file = 1;
+    snprintf(lines[l].text, sizeof(lines[0].text), "%s", path);
+
+    while (fgets(buf, sizeof(buf), f))
+    {
+        char *arg[8] = {0};
+        char *quoted = NULL;
+        char *p = buf;
+        int argn = 0;
+        int start = size;
+
+        line_no++;
+
+        // split on spaces, a "string" is one argument, # to the end is a comment
+        while (*p && argn < 8)
+        {
+            while (isspace((unsigned char)*p))
+                p++;
+            if (!*p || *p == '#')
+                break;
+            if (*p == '"')
+            {
+                quoted = ++p;
+                while (*p && *p != '"')
+                    p++;
+                if (*p != '"')
+                    fail("unterminated string");
+                *p++ = 0;
+                arg[argn++] = quoted;
+                continue;
+            }
+            arg[argn++] = p;
+            while (*p && !isspace((unsigned char)*p))
+                p++;
+            if (*p)
+                *p++ = 0;
+        }
+        if (!argn)
+            continue;
+
+        const char *op = arg[0];
+        int conditional = chance >= 0;
+
+        if (conditional && (!strcmp(op, "loop") || !strcmp(op, "next")))
+            fail("chance can't skip %s", op);
+
+        if (!strcmp(op, "color") && argn == 4)
+        {
+            emit(PAT_COLOR);
+            color(arg + 1);
+        }
+        else if (!strcmp(op, "random") && argn == 1)
+        {
+            emit(PAT_RANDOM);
+        }
+        else if (!strcmp(op, "level") && argn == 2)
+        {
+            emit(PAT_LEVEL);
+            emit(number(arg[1], 0, 255, "level"));
+        }
+        else if (!strcmp(op, "fade") && argn == 6)
+        {
+            int t = ticks(arg[2], 255);
+            emit(PAT_FADE | frames(arg[1]));
+            emit(t);
+            color(arg + 3);
+            sleeps |= !conditional && t;
+        }
+        else if (!strcmp(op, "ramp") && argn == 4)
+        {
+            int t = ticks(arg[2], 255);
+            emit(PAT_RAMP | frames(arg[1]));
+            emit(t);
+            emit(number(arg[3], 0, 255, "level"));
+            sleeps |= !conditional && t;
+        }
+        else if (!strcmp(op, "wait") && argn == 2)
+        {
+            int t = ticks(arg[1], PAT_WAIT_MAX);
+            emit(PAT_WAIT);
+            emit(t & 0xff);
+            emit(t >> 8);
+            sleeps |= !conditional && t;
+        }
+        else if (!strcmp(op, "loop") && argn == 2)
+        {
+            if (loop >= 0)
+                fail("loops don't nest");
+            loop_count = number(arg[1], 1, 255, "loop count");
+            loop = size;
+        }
+        else if (!strcmp(op, "next") && argn == 1)
+        {
+            int end = size;
+
+            if (loop < 0)
+                fail("next without loop");
+            for (int i = 1; i < loop_count; i++)
+                for (int j = loop; j < end; j++)
+                    emit(code[j]);
+            loop = -1;
+        }
+        else if (!strcmp(op, "chance") && argn == 2)
+        {
+            char *slash = strchr(arg[1], '/');
+            if (!slash)
+                fail("chance takes a fraction P/Q, not '%s'", arg[1]);
+            *slash = 0;
+            long q = number(slash + 1, 1, 255, "Q");
+            long num = number(arg[1], 1, q, "P");
+            *slash = '/';
+            emit(PAT_CHANCE);
+            emit((num * 256 + q / 2) / q - 1); // the skip is set by the next op
+        }
+        else if (!strcmp(op, "morse") && argn == 3 && quoted == arg[2])
+        {
+            static uint8_t stream[4096];
+            unsigned bits;
+            int t = ticks(arg[1], 255);
+
+            memset(stream, 0, sizeof(stream));
+            if (morse_encode(arg[2], stream, sizeof(stream), &bits))
+                fail("bad message");
+            // a whole number of bytes per op, so each starts on bit 7
+            for (unsigned i = 0; i < bits; i += 248)
+            {
+                unsigned count = bits - i < 248 ? bits - i : 248;
+                emit(PAT_MORSE);
+                emit(count);
+                emit(t);
+                for (unsigned j = 0; j < (count + 7) / 8; j++)
+                    emit(stream[i / 8 + j]);
+            }
+            sleeps |= !conditional && t;
+        }
+        else if (!strcmp(op, "dark") && argn == 1)
+        {
+            emit(PAT_DARK);
+            sleeps |= !conditional;
+        }
+        else
+        {
+            fail("can't assemble '%s' with %d arguments", op, argn - 1);
+        }
+
+        if (!strcmp(op, "chance"))
+        {
+            if (chance >= 0)
+                fail("chance can't skip chance");
+            chance = start;
+        }
+        else if (chance >= 0)
+        {
+            if (size - start > 15)
+                fail("%s is %d bytes, chance can only skip 15", op, size - start);
+            code[chance] |= size - start;
+            chance = -1;
+        }
+
+        l = listed();
+        lines[l].start = start;
+        lines[l].end = size;
+        snprintf(lines[l].text, sizeof(lines[0].text), "%d: %s", line_no, op);
+        for (int i = 1; i < argn; i++)
+        {
+            size_t len = strlen(lines[l].text);
+            snprintf(lines[l].text + len, sizeof(lines[0].text) - len,
+                     arg[i] == quoted ? " \"%s\"" : " %s", arg[i]);
+        }
+    }
+    fclose(f);
+
+    if (loop >= 0)
+        fail("loop without next");
+    if (chance >= 0)
+        fail("chance at the end of the pattern");
+    if (!sleeps)
+        fail("nothing in the pattern always takes time, it would never sleep");
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc - 1;
+
+    if (count < 1 || count > FILES_MAX)
+    {
+        fprintf(stderr, "usage: pattern file.pat [more.pat ...] > bytecode.h\n");
+        return 2;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        path = argv[i + 1];
+        starts[i] = size;
+        assemble();
+        fprintf(stderr, "pattern: %s is %d bytes\n", path, size - starts[i]);
+    }
+    starts[count] = size;
+
+    printf("// Generated by tools/pattern from");
+    for (int i = 0; i < count; i++)
+        printf(" %s", argv[i + 1]);
+    printf(", don't edit\n\n");
+    printf("#define PATTERN_COUNT %d\n\n", count);
+
+    // where each pattern starts, and where the last one ends
+    printf("const uint8_t pattern_start[] PROGMEM = {");
+    for (int i = 0; i <= count; i++)
+        printf("%s%d", i ? ", " : "", starts[i]);
+    printf("};\n\n");
+
+    printf("const uint8_t pattern[] PROGMEM = {\n");
+    for (int i = 0; i < line_count; i++)
+    {
+        int col = 4;
+        if (lines[i].file)
+        {
+            printf("    // %s\n", lines[i].text);
+            continue;
+        }
+        printf("    ");
+        for (int j = lines[i].start; j < lines[i].end; j++)
+        {
+            if (col > 64)
+            {
+                printf("\n    ");
+                col = 4;
+            }
+            col += printf("0x%02x, ", code[j]);
+        }
+        printf("%*s// %s\n", col < 40 ? 40 - col : 1, "", lines[i].text);
+    }
+    printf("};\n");
+
+    fprintf(stderr, "pattern: %d bytes in all, %d for the table\n", size + count + 1,
+            count + 1);
+    return 0;
+}
@@ -0,0 +1,364 @@
+/*
+tiny_rand() next to the 8-bit LFSR it replaced and lib8tion's random8().
+
+    randtest [-n DRAWS] [-b avrgcc/rand-none.elf avrgcc/rand-*.elf]
+
+For every generator, started the way the firmware starts it:
+
+    period    draws until the state comes round again
+    chi2      of the DRAWS bytes (default 4096, 16 a bin and a small
+              part of the 16-bit periods, over a whole one every value
+              comes up equally often) in 256 bins, 255 degrees of
+              freedom, and p, the chance of a larger value from a uniform
+              source: tiny p is biased, p near 1 too even to be random
+    serial    lag-1 serial correlation coefficient of the same bytes,
+              within +-2/sqrt(DRAWS) for independent draws
+    streams   distinct first 16 bytes over 1000 power-ons, each of which
+              sees RAND_SEED_READINGS readings of 128 with +-1 count of
+              noise; 1 means every throwie plays in lockstep
+
+With -b and images built from randtest_avr.c (./build.sh rand does both),
+each image runs on the AVRrc model for cycles per call, min/avg/max, and
+the flash the generator adds, both relative to the -b image, like
+lib8bench. Images are matched to rows by name, avrgcc/rand-NAME.elf.
+*/
+
+#include "avrrc.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../lib8tion/lib8tion.h"
+#include "../tinyrand.h"
+
+#define RAND_SEED_READINGS 16 // as in main.c
+#define POWER_ONS 1000
+
+uint16_t rand16seed;
+
+// tiny_rand() before tinyrand.h, always started at 1
+static uint8_t lfsr;
+
+static uint8_t lfsr8(void)
+{
+    uint8_t bit = lfsr & 1;
+    lfsr >>= 1;
+    if (bit)
+        lfsr ^= 0xB4;
+    return lfsr;
+}
+
+static void lfsr8_reset(void)
+{
+    lfsr = 1;
+}
+
+static unsigned lfsr8_state(void)
+{
+    return lfsr;
+}
+
+static void xorshift16_reset(void)
+{
+    rand_state = 1;
+}
+
+static unsigned xorshift16_state(void)
+{
+    return rand_state;
+}
+
+static uint8_t xorshift16(void)
+{
+    return tiny_rand();
+}
+
+static void random8_reset(void)
+{
+    rand16seed = 0;
+}
+
+static unsigned random8_state(void)
+{
+    return rand16seed;
+}
+
+static uint8_t random8_(void)
+{
+    return random8();
+}
+
+typedef struct
+{
+    const char *name;
+    void (*reset)(void);
+    void (*stir)(uint8_t reading); // NULL when the firmware doesn't seed it
+    unsigned (*state)(void);
+    uint8_t (*next)(void);
+} gen_t;
+
+static const gen_t gens[] = {
+    {"lfsr8", lfsr8_reset, NULL, lfsr8_state, lfsr8},
+    {"xorshift16", xorshift16_reset, rand_stir, xorshift16_state, xorshift16},
+    {"random8", random8_reset, NULL, random8_state, random8_},
+};
+
+#define GENS (sizeof(gens) / sizeof(gens[0]))
+
+static unsigned long period(const gen_t *g)
+{
+    unsigned long n = 0;
+
+    g->reset();
+    unsigned start = g->state();
+    do
+    {
+        g->next();
+        n++;
+    } while (g->state() != start && n < 1ul << 24);
+    return n;
+}
+
+// Upper tail of chi-square with k degrees of freedom, Wilson-Hilferty
+static double chi2_p(double x, double k)
+{
+    double z = (cbrt(x / k) - (1 - 2 / (9 * k))) / sqrt(2 / (9 * k));
+    return 0.5 * erfc(z / sqrt(2));
+}
+
+static void stats(const gen_t *g, unsigned long draws, double *chi2, double *serial)
+{
+    unsigned long bins[256] = {0};
+    double sum = 0, sum2 = 0, cross = 0;
+    uint8_t first, prev;
+
+    g->reset();
+    first = prev = g->next();
+    for (unsigned long i = 0; i < draws; i++)
+    {
+        uint8_t v = i ? g->next() : first;
+        bins[v]++;
+        sum += v;
+        sum2 += (double)v * v;
+        if (i)
+            cross += (double)prev * v;
+        prev = v;
+    }
+    cross += (double)prev * first; // circular, as Knuth defines it
+
+    double expect = draws / 256.0;
+    *chi2 = 0;
+    for (int i = 0; i < 256; i++)
+        *chi2 += (bins[i] - expect) * (bins[i] - expect) / expect;
+    *serial = (draws * cross - sum * sum) / (draws * sum2 - sum * sum);
+}
+
+static int compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int streams(const gen_t *g)
+{
+    static uint64_t seen[POWER_ONS];
+    int distinct = 0;
+
+    srand(1);
+    for (int p = 0; p < POWER_ONS; p++)
+    {
+        uint64_t hash = 14695981039346656037ull;
+
+        g->reset();
+        for (int i = 0; i < RAND_SEED_READINGS && g->stir; i++)
+            g->stir(128 + rand() % 3 - 1);
+        for (int i = 0; i < 16; i++)
+            hash = (hash ^ g->next()) * 1099511628211ull;
+        seen[p] = hash;
+    }
+    qsort(seen, POWER_ONS, sizeof(seen[0]), compare);
+    for (int p = 0; p < POWER_ONS; p++)
+        distinct += !p || seen[p] != seen[p - 1];
+    return distinct;
+}
+
+typedef struct
+{
+    uint16_t entry; // word address of bench()
+    int active;
+    uint16_t sp;
+    uint64_t start;
+    uint64_t calls, min, max, total;
+} calls_t;
+
+static void on_call(void *ctx, avr_t *avr, uint16_t target, uint16_t sp)
+{
+    calls_t *t = ctx;
+
+    if (target != t->entry || t->active)
+        return;
+    t->active = 1;
+    t->sp = sp + 2; // SP once the return address is popped
+    t->start = avr->cycles;
+}
+
+static void on_ret(void *ctx, avr_t *avr, uint16_t sp)
+{
+    calls_t *t = ctx;
+
+    if (!t->active || sp != t->sp)
+        return;
+    t->active = 0;
+
+    uint64_t cycles = avr->cycles - t->start;
+    if (!t->calls || cycles < t->min)
+        t->min = cycles;
+    if (cycles > t->max)
+        t->max = cycles;
+    t->total += cycles;
+    t->calls++;
+}
+
+// Run an image to its BREAK, returns 0 and its flash size and cycles per
+// call of bench()
+static int time_image(const char *path, long *bytes, calls_t *t)
+{
+    static avr_t avr;
+    avr_syms_t syms = {0};
+
+    avr_init(&avr);
+    if (avr_load(&avr, path, &syms))
+        return -1;
+
+    const avr_sym_t *sym = avr_sym_find(&syms, "bench");
+    if (!sym || !sym->func)
+    {
+        fprintf(stderr, "%s: no bench() function\n", path);
+        avr_syms_free(&syms);
+        return -1;
+    }
+
+    memset(t, 0, sizeof(*t));
+    t->entry = sym->addr / 2;
+    avr.on_call = on_call;
+    avr.on_ret = on_ret;
+    avr.call_ctx = t;
+
+    avr_run_until(&avr, AVR_OSC_HZ);
+    avr_syms_free(&syms);
+
+    // BREAK stops the model without an error
+    if (!avr.stopped || avr.error[0])
+    {
+        fprintf(stderr, "%s: didn't reach its BREAK%s%s\n", path, avr.error[0] ? ": " : "", avr.error);
+        return -1;
+    }
+    if (!t->calls)
+    {
+        fprintf(stderr, "%s: bench() never returned\n", path);
+        return -1;
+    }
+    *bytes = avr.flash_size;
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: randtest [-n draws] [-b baseline.elf image.elf...]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *baseline = NULL;
+    unsigned long draws = 4096;
+    int opt, failed = 0;
+    struct
+    {
+        int have;
+        double min, avg, max;
+        long bytes;
+    } costs[GENS] = {{0}};
+
+    while ((opt = getopt(argc, argv, "n:b:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            draws = strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            baseline = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if ((!baseline && optind != argc) || draws < 2)
+        usage();
+
+    if (baseline)
+    {
+        calls_t base, t;
+        long base_bytes, bytes;
+
+        if (time_image(baseline, &base_bytes, &base))
+            return 1;
+
+        for (int i = optind; i < argc; i++)
+        {
+            const char *name = strrchr(argv[i], '/');
+            size_t g;
+
+            name = name ? name + 1 : argv[i];
+            if (!strncmp(name, "rand-", 5))
+                name += 5;
+            if (!strcmp(argv[i], baseline))
+                continue;
+            for (g = 0; g < GENS; g++)
+                if (!strncmp(gens[g].name, name, strlen(gens[g].name)) &&
+                    name[strlen(gens[g].name)] == '.')
+                    break;
+            if (g == GENS)
+            {
+                fprintf(stderr, "%s: no generator %s in the table\n", argv[i], name);
+                failed = 1;
+                continue;
+            }
+            if (time_image(argv[i], &bytes, &t))
+            {
+                failed = 1;
+                continue;
+            }
+            costs[g].have = 1;
+            costs[g].min = (double)t.min - base.min;
+            costs[g].max = (double)t.max - base.max;
+            costs[g].avg = (double)t.total / t.calls - (double)base.total / base.calls;
+            costs[g].bytes = bytes - base_bytes;
+        }
+    }
+
+    printf("%lu draws, serial correlation within +-%.4f for independent draws\n\n", draws,
+           2 / sqrt(draws));
+    printf("%-12s %8s %10s %8s %9s %8s", "generator", "period", "chi2", "p", "serial", "streams");
+    if (baseline)
+        printf("  %15s %7s", "cycles min/avg/max", "bytes");
+    printf("\n");
+
+    for (size_t g = 0; g < GENS; g++)
+    {
+        double chi2, serial;
+
+        stats(&gens[g], draws, &chi2, &serial);
+        printf("%-12s %8lu %10.1f %8.4f %9.4f %8d", gens[g].name, period(&gens[g]), chi2,
+               chi2_p(chi2, 255), serial, streams(&gens[g]));
+        if (costs[g].have)
+            printf("  %5.0f/%5.1f/%5.0f %7ld", costs[g].min, costs[g].avg, costs[g].max, costs[g].bytes);
+        printf("\n");
+    }
+
+    return failed;
+}
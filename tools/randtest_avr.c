@@ -0,0 +1,55 @@
+/*
+One random number generator on its own, for tools/randtest to time on the
+AVRrc model. ./build.sh rand builds one image per generator as
+
+    avr-gcc -mmcu=attiny5 -Os -DRNG=xorshift16 -o avrgcc/rand-xorshift16.elf tools/randtest_avr.c
+
+and RNG=none once, which makes the same calls to a function that returns
+a constant: its cycles are the call overhead that gets taken off, its
+size the flash every image has anyway.
+*/
+
+#include <avr/io.h>
+
+#include "../lib8tion/lib8tion.h"
+#include "../tinyrand.h"
+
+uint16_t rand16seed;
+
+// tiny_rand() before tinyrand.h
+static uint8_t lfsr = 1;
+
+static inline uint8_t lfsr8(void)
+{
+    uint8_t bit = lfsr & 1;
+    lfsr >>= 1;
+    if (bit)
+    {
+        lfsr ^= 0xB4;
+    }
+    return lfsr;
+}
+
+#define none() 0
+#define xorshift16() tiny_rand()
+
+#define BENCH_FN __attribute__((noipa))
+
+volatile uint8_t sink;
+
+BENCH_FN uint8_t bench(void)
+{
+    return RNG();
+}
+
+int main(void)
+{
+    uint8_t i = 0;
+    do
+    {
+        sink = bench();
+    } while (++i);
+
+    asm volatile("break");
+    return 0;
+}